@@ -0,0 +1,120 @@
+#ifndef EASY_ASYNC_NATIVE_ARDUINO_H
+#define EASY_ASYNC_NATIVE_ARDUINO_H
+
+// Host (native) stand-in for the parts of the Arduino core EasyAsync touches:
+// timing, delays, random() and a Serial that writes to stdout.
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+inline unsigned long millis() {
+    return (unsigned long)(easyasync_native::microsNow() / 1000);
+}
+
+inline unsigned long micros() {
+    return (unsigned long)easyasync_native::microsNow();
+}
+
+inline void delay(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+inline void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline long random(long lo, long hi) {
+    thread_local std::minstd_rand rng(std::random_device{}());
+    if (hi <= lo) return lo;
+    return lo + (long)(rng() % (unsigned long)(hi - lo));
+}
+
+inline long random(long hi) {
+    return random(0, hi);
+}
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+
+    size_t write(const char* str) {
+        return str ? write((const uint8_t*)str, strlen(str)) : 0;
+    }
+
+    size_t printf(const char* format, ...) {
+        char small[128];
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        int len = vsnprintf(small, sizeof(small), format, copy);
+        va_end(copy);
+        size_t written = 0;
+        if (len < 0) {
+            written = 0;
+        } else if ((size_t)len < sizeof(small)) {
+            written = write((const uint8_t*)small, (size_t)len);
+        } else {
+            char* big = new char[(size_t)len + 1];
+            vsnprintf(big, (size_t)len + 1, format, args);
+            written = write((const uint8_t*)big, (size_t)len);
+            delete[] big;
+        }
+        va_end(args);
+        return written;
+    }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println() { return write((uint8_t)'\n'); }
+
+    template<typename T>
+    size_t println(T value) {
+        size_t n = print(value);
+        return n + println();
+    }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() { fflush(stdout); }
+    explicit operator bool() const { return true; }
+
+    using Print::write;
+
+    size_t write(uint8_t c) override {
+        return fwrite(&c, 1, 1, stdout);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+inline HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef EASY_ASYNC_NATIVE_ESP_FREERTOS_HOOKS_H
+#define EASY_ASYNC_NATIVE_ESP_FREERTOS_HOOKS_H
+
+// Host stand-in for ESP-IDF's idle hooks. Each core gets an IDLE task, started
+// with its first hook, that calls the registered hooks about once a tick.
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_NO_MEM 0x101
+
+typedef bool (*esp_freertos_idle_cb_t)(void);
+
+namespace easyasync_native {
+
+constexpr int kIdleHooksPerCore = 8;
+
+struct IdleHooks {
+    std::mutex lock;
+    esp_freertos_idle_cb_t hooks[portNUM_PROCESSORS][kIdleHooksPerCore] = {};
+    bool started[portNUM_PROCESSORS] = {};
+};
+
+inline IdleHooks& idleHooks() {
+    static IdleHooks* hooks = new IdleHooks();
+    return *hooks;
+}
+
+inline void idleTask(void* param) {
+    int core = (int)(intptr_t)param;
+    IdleHooks& idle = idleHooks();
+    while (true) {
+        esp_freertos_idle_cb_t current[kIdleHooksPerCore];
+        {
+            std::lock_guard<std::mutex> lk(idle.lock);
+            memcpy(current, idle.hooks[core], sizeof(current));
+        }
+        for (esp_freertos_idle_cb_t hook : current) {
+            if (hook != nullptr) {
+                hook();
+            }
+        }
+        vTaskDelay(1);
+    }
+}
+
+}  // namespace easyasync_native
+
+inline esp_err_t esp_register_freertos_idle_hook_for_cpu(esp_freertos_idle_cb_t cb,
+                                                         UBaseType_t cpuid) {
+    using namespace easyasync_native;
+    IdleHooks& idle = idleHooks();
+    std::lock_guard<std::mutex> lk(idle.lock);
+    for (esp_freertos_idle_cb_t& slot : idle.hooks[cpuid]) {
+        if (slot == nullptr) {
+            slot = cb;
+            if (!idle.started[cpuid]) {
+                idle.started[cpuid] = true;
+                xTaskCreatePinnedToCore(idleTask, "IDLE", 1024, (void*)(intptr_t)cpuid, 0,
+                                        nullptr, (BaseType_t)cpuid);
+            }
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+inline void esp_deregister_freertos_idle_hook(esp_freertos_idle_cb_t cb) {
+    using namespace easyasync_native;
+    IdleHooks& idle = idleHooks();
+    std::lock_guard<std::mutex> lk(idle.lock);
+    for (auto& core : idle.hooks) {
+        for (esp_freertos_idle_cb_t& slot : core) {
+            if (slot == cb) {
+                slot = nullptr;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef EASY_ASYNC_NATIVE_FREERTOS_H
+#define EASY_ASYNC_NATIVE_FREERTOS_H
+
+// Host (native) stand-in for the subset of ESP-IDF FreeRTOS used by EasyAsync.
+// Tasks are std::threads, ticks are milliseconds and "cores" are a label
+// assigned to each thread so core-pinning logic can still be exercised.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY ((BaseType_t)-1)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+#define portNUM_PROCESSORS 2
+#define configMAX_PRIORITIES 25
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 1
+#define configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS 1
+
+#define configASSERT(x) do { if (!(x)) { std::abort(); } } while (0)
+
+struct portMUX_TYPE {
+    std::recursive_mutex lock;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE{}
+#define portENTER_CRITICAL(mux) (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux) (mux)->lock.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+
+namespace easyasync_native {
+
+// Thrown out of kernel calls made by a task that has been deleted, so the
+// thread unwinds back to its trampoline the next time it touches the kernel.
+struct TaskExit {};
+
+struct Task;
+
+struct Kernel {
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex lock;
+    std::atomic<uint32_t> nextCore{0};
+};
+
+inline Kernel& kernel() {
+    static Kernel* k = new Kernel();
+    return *k;
+}
+
+inline TickType_t ticksNow() {
+    auto elapsed = std::chrono::steady_clock::now() - kernel().epoch;
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+inline uint64_t microsNow() {
+    auto elapsed = std::chrono::steady_clock::now() - kernel().epoch;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+inline Task* currentTask();
+inline bool stopRequested();
+inline void checkKilled();
+
+// Blocking waits are sliced so a deleted or suspended task notices within a
+// few ms. The caller's lock is dropped while the task is stopped, so a
+// suspended waiter never holds up the task that suspended it.
+constexpr auto kWaitSlice = std::chrono::milliseconds(5);
+
+template<typename Pred>
+bool waitFor(std::unique_lock<std::mutex>& lk, std::condition_variable& cv,
+             TickType_t ticks, Pred pred) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    while (!pred()) {
+        if (stopRequested()) {
+            lk.unlock();
+            checkKilled();
+            lk.lock();
+            continue;
+        }
+        if (ticks == 0) return false;
+        auto now = std::chrono::steady_clock::now();
+        if (ticks != portMAX_DELAY && now >= deadline) return pred();
+        auto until = now + kWaitSlice;
+        if (ticks != portMAX_DELAY && deadline < until) until = deadline;
+        cv.wait_until(lk, until);
+    }
+    return true;
+}
+
+}  // namespace easyasync_native
+
+inline BaseType_t xPortGetCoreID();
+
+#endif
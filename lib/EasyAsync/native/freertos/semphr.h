@@ -0,0 +1,118 @@
+#ifndef EASY_ASYNC_NATIVE_SEMPHR_H
+#define EASY_ASYNC_NATIVE_SEMPHR_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <new>
+
+namespace easyasync_native {
+
+struct Semaphore {
+    std::mutex lock;
+    std::condition_variable cv;
+    UBaseType_t count = 0;
+    UBaseType_t maxCount = 1;
+    bool isMutex = false;
+    // Heap block to free on delete; null for semaphores built in a caller's
+    // StaticSemaphore_t. Kept as data, not a flag, so the optimizer never
+    // sees a path that frees a static buffer.
+    void* allocation = nullptr;
+    Task* owner = nullptr;
+};
+
+}  // namespace easyasync_native
+
+typedef easyasync_native::Semaphore* SemaphoreHandle_t;
+
+struct StaticSemaphore_t {
+    alignas(std::max_align_t) unsigned char storage[160];
+};
+
+static_assert(sizeof(easyasync_native::Semaphore) <= sizeof(StaticSemaphore_t),
+              "StaticSemaphore_t too small for the native semaphore");
+
+namespace easyasync_native {
+
+inline SemaphoreHandle_t makeSemaphore(void* where, UBaseType_t maxCount, UBaseType_t initial,
+                                       bool isMutex) {
+    void* allocation = nullptr;
+    if (where == nullptr) {
+        allocation = ::operator new(sizeof(Semaphore), std::nothrow);
+        if (allocation == nullptr) return nullptr;
+        where = allocation;
+    }
+    Semaphore* sem = new (where) Semaphore();
+    sem->maxCount = maxCount;
+    sem->count = initial;
+    sem->isMutex = isMutex;
+    sem->allocation = allocation;
+    return sem;
+}
+
+}  // namespace easyasync_native
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return easyasync_native::makeSemaphore(nullptr, 1, 1, true);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return easyasync_native::makeSemaphore(nullptr, 1, 0, false);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initial) {
+    return easyasync_native::makeSemaphore(nullptr, maxCount, initial, false);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer) {
+    return easyasync_native::makeSemaphore(buffer, 1, 1, true);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+    return easyasync_native::makeSemaphore(buffer, 1, 0, false);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t maxCount, UBaseType_t initial,
+                                                        StaticSemaphore_t* buffer) {
+    return easyasync_native::makeSemaphore(buffer, maxCount, initial, false);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    void* allocation = sem->allocation;
+    sem->~Semaphore();
+    ::operator delete(allocation);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    using namespace easyasync_native;
+    std::unique_lock<std::mutex> lk(sem->lock);
+    if (!waitFor(lk, sem->cv, ticks, [sem]() { return sem->count > 0; })) {
+        return pdFALSE;
+    }
+    sem->count--;
+    if (sem->isMutex) sem->owner = currentTask();
+    return pdTRUE;
+}
+
+// Notifies under the lock so a woken waiter may delete the semaphore as soon
+// as its take returns, as it can on FreeRTOS.
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    std::lock_guard<std::mutex> lk(sem->lock);
+    if (sem->count >= sem->maxCount) return pdFALSE;
+    sem->count++;
+    sem->owner = nullptr;
+    sem->cv.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken) {
+    if (woken != nullptr) *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+inline UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem) {
+    std::lock_guard<std::mutex> lk(sem->lock);
+    return sem->count;
+}
+
+#endif
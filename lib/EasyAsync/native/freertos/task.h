@@ -0,0 +1,412 @@
+#ifndef EASY_ASYNC_NATIVE_TASK_H
+#define EASY_ASYNC_NATIVE_TASK_H
+
+#include "FreeRTOS.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+typedef void (*TaskFunction_t)(void*);
+typedef void (*TlsDeleteCallbackFunction_t)(int, void*);
+
+struct StaticTask_t {
+    void* reserved[4];
+};
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+namespace easyasync_native {
+
+struct Task {
+    char name[16] = {0};
+    TaskFunction_t entry = nullptr;
+    void* param = nullptr;
+    uint32_t stackDepth = 0;
+    std::atomic<UBaseType_t> priority{0};
+    BaseType_t core = 0;
+    BaseType_t affinity = tskNO_AFFINITY;
+    std::atomic<bool> killed{false};
+    std::atomic<bool> finished{false};
+
+    // Suspension only takes effect at the task's next kernel call, so
+    // eTaskGetState() reports eRunning until the task has actually parked.
+    std::mutex parkLock;
+    std::condition_variable parkCv;
+    std::atomic<bool> suspended{false};
+    std::atomic<bool> parked{false};
+    bool selfSuspended = false;
+
+    std::mutex notifyLock;
+    std::condition_variable notifyCv;
+    uint32_t notifyValue = 0;
+    bool notifyPending = false;
+
+    void* tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS] = {nullptr};
+    TlsDeleteCallbackFunction_t tlsDelete[configNUM_THREAD_LOCAL_STORAGE_POINTERS] = {nullptr};
+};
+
+// Task objects are never freed so stale handles stay safe to inspect; the
+// registry keeps them reachable for leak checkers.
+inline std::vector<std::unique_ptr<Task>>& registry() {
+    static auto* tasks = new std::vector<std::unique_ptr<Task>>();
+    return *tasks;
+}
+
+inline Task*& currentSlot() {
+    thread_local Task* current = nullptr;
+    return current;
+}
+
+inline Task* adoptThread(const char* name, BaseType_t core) {
+    auto task = std::make_unique<Task>();
+    // Truncated like configMAX_TASK_NAME_LEN; name[] is already zeroed.
+    if (name != nullptr) {
+        memcpy(task->name, name, strnlen(name, sizeof(task->name) - 1));
+    }
+    task->core = core;
+    task->affinity = core;
+    Task* raw = task.get();
+    std::lock_guard<std::mutex> lk(kernel().lock);
+    registry().push_back(std::move(task));
+    return raw;
+}
+
+inline Task* currentTask() {
+    Task*& slot = currentSlot();
+    if (slot == nullptr) {
+        // Threads not created through xTaskCreate (e.g. main) behave like the
+        // Arduino loop task, which runs on core 1.
+        slot = adoptThread("loopTask", 1);
+    }
+    return slot;
+}
+
+inline bool stopRequested() {
+    Task* self = currentSlot();
+    return self != nullptr && (self->killed || self->suspended);
+}
+
+// Stops the calling task if it has been suspended or deleted. A task deleted
+// while running, or while suspended at a point it chose itself, unwinds back
+// to its trampoline. One suspended by another task and then deleted never
+// runs again: its body may already be freed, as on FreeRTOS.
+inline void checkKilled() {
+    if (!stopRequested()) {
+        return;
+    }
+    Task* self = currentSlot();
+    std::unique_lock<std::mutex> lk(self->parkLock);
+    while (true) {
+        bool frozen = self->suspended && !self->selfSuspended;
+        if (self->killed && !frozen) {
+            self->parked = false;
+            throw TaskExit();
+        }
+        if (!self->killed && !self->suspended) {
+            break;
+        }
+        self->parked = true;
+        self->parkCv.wait(lk);
+    }
+    self->parked = false;
+}
+
+inline void runTlsDeleteCallbacks(Task* task) {
+    for (int i = 0; i < configNUM_THREAD_LOCAL_STORAGE_POINTERS; i++) {
+        if (task->tlsDelete[i] != nullptr) {
+            task->tlsDelete[i](i, task->tls[i]);
+        }
+    }
+}
+
+inline void finishTask(Task* task) {
+    runTlsDeleteCallbacks(task);
+    task->finished = true;
+}
+
+}  // namespace easyasync_native
+
+typedef easyasync_native::Task* TaskHandle_t;
+
+namespace easyasync_native {
+
+// No ESP32 heap could hold a stack this deep; creation fails as it would there.
+constexpr uint32_t kMaxStackDepth = 256 * 1024;
+
+inline BaseType_t spawn(TaskFunction_t fn, const char* name, uint32_t depth, void* param,
+                        UBaseType_t priority, TaskHandle_t* out, BaseType_t affinity) {
+    if (depth > kMaxStackDepth) {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+    BaseType_t core = affinity;
+    if (core == tskNO_AFFINITY) {
+        core = (BaseType_t)(kernel().nextCore.fetch_add(1) % portNUM_PROCESSORS);
+    }
+    Task* task = adoptThread(name, core);
+    task->affinity = affinity;
+    task->entry = fn;
+    task->param = param;
+    task->stackDepth = depth;
+    task->priority = priority;
+    if (out != nullptr) {
+        *out = task;
+    }
+    try {
+        std::thread([task]() {
+            currentSlot() = task;
+            try {
+                task->entry(task->param);
+            } catch (const TaskExit&) {
+            }
+            finishTask(task);
+        }).detach();
+    } catch (...) {
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+}  // namespace easyasync_native
+
+inline BaseType_t xPortGetCoreID() {
+    return easyasync_native::currentTask()->core;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t depth,
+                                          void* param, UBaseType_t priority,
+                                          TaskHandle_t* out, BaseType_t core) {
+    return easyasync_native::spawn(fn, name, depth, param, priority, out, core);
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t depth,
+                              void* param, UBaseType_t priority, TaskHandle_t* out) {
+    return easyasync_native::spawn(fn, name, depth, param, priority, out, tskNO_AFFINITY);
+}
+
+inline TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name,
+                                                  uint32_t depth, void* param,
+                                                  UBaseType_t priority, StackType_t* stack,
+                                                  StaticTask_t* tcb, BaseType_t core) {
+    (void)stack;
+    (void)tcb;
+    TaskHandle_t handle = nullptr;
+    easyasync_native::spawn(fn, name, depth, param, priority, &handle, core);
+    return handle;
+}
+
+inline TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char* name, uint32_t depth,
+                                      void* param, UBaseType_t priority,
+                                      StackType_t* stack, StaticTask_t* tcb) {
+    return xTaskCreateStaticPinnedToCore(fn, name, depth, param, priority, stack, tcb,
+                                         tskNO_AFFINITY);
+}
+
+// A task suspended by someone else is reaped by the caller, like FreeRTOS
+// freeing a TCB that can no longer run; any other task unwinds at its next
+// kernel call and cleans up after itself.
+inline void vTaskDelete(TaskHandle_t task) {
+    using namespace easyasync_native;
+    Task* self = currentTask();
+    if (task == nullptr || task == self) {
+        self->killed = true;
+        throw TaskExit();
+    }
+    bool frozen;
+    {
+        std::lock_guard<std::mutex> lk(task->parkLock);
+        frozen = task->suspended && !task->selfSuspended;
+        task->killed = true;
+        task->parkCv.notify_all();
+    }
+    task->notifyCv.notify_all();
+    if (frozen) {
+        finishTask(task);
+    }
+}
+
+inline void vTaskSuspend(TaskHandle_t task) {
+    using namespace easyasync_native;
+    Task* self = currentTask();
+    if (task == nullptr) task = self;
+    {
+        std::lock_guard<std::mutex> lk(task->parkLock);
+        task->suspended = true;
+        task->selfSuspended = task == self;
+    }
+    task->notifyCv.notify_all();
+    if (task == self) {
+        checkKilled();
+    }
+}
+
+inline void vTaskResume(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lk(task->parkLock);
+    task->suspended = false;
+    task->selfSuspended = false;
+    task->parkCv.notify_all();
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return easyasync_native::ticksNow();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    using namespace easyasync_native;
+    checkKilled();
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    while (std::chrono::steady_clock::now() < until) {
+        auto slice = std::chrono::steady_clock::now() + kWaitSlice;
+        std::this_thread::sleep_until(slice < until ? slice : until);
+        checkKilled();
+    }
+    if (ticks == 0) {
+        std::this_thread::yield();
+    }
+}
+
+inline BaseType_t xTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    TickType_t target = *previousWake + increment;
+    TickType_t now = xTaskGetTickCount();
+    *previousWake = target;
+    if ((int32_t)(target - now) <= 0) {
+        easyasync_native::checkKilled();
+        return pdFALSE;
+    }
+    vTaskDelay(target - now);
+    return pdTRUE;
+}
+
+inline void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    xTaskDelayUntil(previousWake, increment);
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return easyasync_native::currentTask();
+}
+
+inline char* pcTaskGetName(TaskHandle_t task) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->name;
+}
+
+inline eTaskState eTaskGetState(TaskHandle_t task) {
+    if (task->finished || task->killed) return eDeleted;
+    if (task->parked) return eSuspended;
+    if (task->suspended) return eRunning;
+    return task == easyasync_native::currentSlot() ? eRunning : eBlocked;
+}
+
+// Host threads have no watermark to sample; report the full depth as unused.
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->stackDepth;
+}
+
+inline BaseType_t xTaskGetAffinity(TaskHandle_t task) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->affinity;
+}
+
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->priority;
+}
+
+inline void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    task->priority = priority;
+}
+
+inline void taskYIELD() {
+    easyasync_native::checkKilled();
+    std::this_thread::yield();
+}
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    {
+        std::lock_guard<std::mutex> lk(task->notifyLock);
+        switch (action) {
+            case eSetBits: task->notifyValue |= value; break;
+            case eIncrement: task->notifyValue++; break;
+            case eSetValueWithOverwrite: task->notifyValue = value; break;
+            case eSetValueWithoutOverwrite:
+                if (task->notifyPending) return pdFAIL;
+                task->notifyValue = value;
+                break;
+            case eNoAction: break;
+        }
+        task->notifyPending = true;
+        task->notifyCv.notify_all();
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    using namespace easyasync_native;
+    Task* self = currentTask();
+    std::unique_lock<std::mutex> lk(self->notifyLock);
+    waitFor(lk, self->notifyCv, ticks, [self]() { return self->notifyValue != 0; });
+    uint32_t value = self->notifyValue;
+    if (value != 0) {
+        self->notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    self->notifyPending = false;
+    return value;
+}
+
+inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                                  uint32_t* value, TickType_t ticks) {
+    using namespace easyasync_native;
+    Task* self = currentTask();
+    std::unique_lock<std::mutex> lk(self->notifyLock);
+    if (!self->notifyPending) {
+        self->notifyValue &= ~clearOnEntry;
+    }
+    bool got = waitFor(lk, self->notifyCv, ticks, [self]() { return self->notifyPending; });
+    if (value != nullptr) *value = self->notifyValue;
+    if (got) {
+        self->notifyValue &= ~clearOnExit;
+        self->notifyPending = false;
+    }
+    return got ? pdTRUE : pdFALSE;
+}
+
+inline void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t task, BaseType_t index,
+                                                            void* value,
+                                                            TlsDeleteCallbackFunction_t cb) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    task->tls[index] = value;
+    task->tlsDelete[index] = cb;
+}
+
+inline void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void* value) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    task->tls[index] = value;
+}
+
+inline void* pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index) {
+    if (task == nullptr) task = xTaskGetCurrentTaskHandle();
+    return task->tls[index];
+}
+
+#endif
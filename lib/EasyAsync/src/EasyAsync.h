@@ -3,356 +3,4294 @@
 
 #define NOCALLBACK [](){}
 
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <exception>
 #include <functional>
 #include <memory>
-#include <queue>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <esp_freertos_hooks.h>
 
-#define ASYNC_DEBUG 1
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+    #if __has_include(<coroutine>)
+        #include <coroutine>
+        #define ASYNC_HAS_COROUTINES 1
+    #endif
+#endif
+
+#ifndef ASYNC_HAS_COROUTINES
+    #define ASYNC_HAS_COROUTINES 0
+#endif
+
+#define ASYNC_LOG_LEVEL_NONE 0
+#define ASYNC_LOG_LEVEL_ERROR 1
+#define ASYNC_LOG_LEVEL_WARN 2
+#define ASYNC_LOG_LEVEL_INFO 3
+#define ASYNC_LOG_LEVEL_DEBUG 4
+
+#ifndef ASYNC_LOG_LEVEL
+    #ifdef ASYNC_DEBUG
+        #define ASYNC_LOG_LEVEL ASYNC_LOG_LEVEL_DEBUG
+    #else
+        #define ASYNC_LOG_LEVEL ASYNC_LOG_LEVEL_NONE
+    #endif
+#endif
+
+#ifdef ASYNC_LOG_DEFERRED
+    #define ASYNC_LOG_WRITE(tag, fmt, ...) AsyncLog::instance().write("[EasyAsync][" tag "] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define ASYNC_LOG_WRITE(tag, fmt, ...) Serial.printf("[EasyAsync][" tag "] " fmt "\n", ##__VA_ARGS__)
+#endif
+
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_LEVEL_ERROR
+    #define ASYNC_LOGE(fmt, ...) ASYNC_LOG_WRITE("E", fmt, ##__VA_ARGS__)
+#else
+    #define ASYNC_LOGE(fmt, ...)
+#endif
+
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_LEVEL_WARN
+    #define ASYNC_LOGW(fmt, ...) ASYNC_LOG_WRITE("W", fmt, ##__VA_ARGS__)
+#else
+    #define ASYNC_LOGW(fmt, ...)
+#endif
+
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_LEVEL_INFO
+    #define ASYNC_LOGI(fmt, ...) ASYNC_LOG_WRITE("I", fmt, ##__VA_ARGS__)
+#else
+    #define ASYNC_LOGI(fmt, ...)
+#endif
+
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_LEVEL_DEBUG
+    #define ASYNC_LOGD(fmt, ...) ASYNC_LOG_WRITE("D", fmt, ##__VA_ARGS__)
+#else
+    #define ASYNC_LOGD(fmt, ...)
+#endif
+
+#define ASYNC_LOG(fmt, ...) ASYNC_LOGD(fmt, ##__VA_ARGS__)
+
+#ifdef ASYNC_TRACE
+    #define ASYNC_TRACE_EVENT(type, name, id, startUs) AsyncTrace::instance().record(type, name, id, startUs)
+#else
+    #define ASYNC_TRACE_EVENT(type, name, id, startUs)
+#endif
+
+#ifndef ASYNC_TASK_CAPACITY
+    #define ASYNC_TASK_CAPACITY 64
+#endif
+
+#ifndef ASYNC_CALLBACK_CAPACITY
+    #define ASYNC_CALLBACK_CAPACITY 32
+#endif
+
+template<typename Signature, size_t Capacity>
+class InplaceFunction;
+
+template<typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    InplaceFunction() noexcept : ops(nullptr) {}
+
+    InplaceFunction(std::nullptr_t) noexcept : ops(nullptr) {}
+
+    template<typename F, typename Fn = typename std::decay<F>::type,
+             typename = typename std::enable_if<!std::is_same<Fn, InplaceFunction>::value>::type>
+    InplaceFunction(F&& f) : ops(&OpsFor<Fn>::table) {
+        static_assert(sizeof(Fn) <= Capacity,
+                      "Callable captures too much for InplaceFunction; capture less or raise "
+                      "ASYNC_TASK_CAPACITY / ASYNC_CALLBACK_CAPACITY");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t),
+                      "Callable is over-aligned for InplaceFunction");
+        new (storage) Fn(std::forward<F>(f));
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->relocate(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->relocate(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return ops != nullptr;
+    }
+
+    R operator()(Args... args) {
+        return ops->invoke(storage, std::forward<Args>(args)...);
+    }
+
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        R (*invoke)(void*, Args&&...);
+        void (*relocate)(void*, void*);
+        void (*destroy)(void*);
+    };
+
+    template<typename Fn>
+    struct OpsFor {
+        static R invoke(void* self, Args&&... args) {
+            return (*static_cast<Fn*>(self))(std::forward<Args>(args)...);
+        }
+
+        static void relocate(void* dst, void* src) {
+            Fn* from = static_cast<Fn*>(src);
+            new (dst) Fn(std::move(*from));
+            from->~Fn();
+        }
+
+        static void destroy(void* self) {
+            static_cast<Fn*>(self)->~Fn();
+        }
+
+        static constexpr Ops table = {&invoke, &relocate, &destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage[Capacity];
+    const Ops* ops;
+};
+
+template<typename R, typename... Args, size_t Capacity>
+template<typename Fn>
+constexpr typename InplaceFunction<R(Args...), Capacity>::Ops
+    InplaceFunction<R(Args...), Capacity>::OpsFor<Fn>::table;
+
+using TaskFunction = InplaceFunction<void(), ASYNC_TASK_CAPACITY>;
+using CallbackFunction = InplaceFunction<void(), ASYNC_CALLBACK_CAPACITY>;
+
+struct Unit {};
+
+// Thrown by Future::get() and co_await when the future failed, was
+// cancelled or is empty.
+class FutureError : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "future failed";
+    }
+};
+
+template<typename T>
+struct FutureValue {
+    using Type = T;
+    using Ref = T&;
+
+    template<typename F>
+    static T compute(F& f) {
+        return f();
+    }
+
+    template<typename F>
+    static auto apply(F& f, T& value) -> decltype(f(value)) {
+        return f(value);
+    }
+
+    static T& unwrap(T& value) {
+        return value;
+    }
+
+    // Copies when it can, so other holders of the future still see the
+    // value; move-only results are moved out.
+    static T take(T& value) {
+        return take(value, std::is_copy_constructible<T>());
+    }
+
+private:
+    static T take(T& value, std::true_type) {
+        return value;
+    }
+
+    static T take(T& value, std::false_type) {
+        return std::move(value);
+    }
+};
+
+template<>
+struct FutureValue<void> {
+    using Type = Unit;
+    using Ref = void;
+
+    template<typename F>
+    static Unit compute(F& f) {
+        f();
+        return Unit();
+    }
+
+    template<typename F>
+    static auto apply(F& f, Unit&) -> decltype(f()) {
+        return f();
+    }
+
+    static void unwrap(Unit&) {}
+
+    static void take(Unit&) {}
+};
+
+#ifndef ASYNC_TIMER_WHEEL_SLOTS
+    #define ASYNC_TIMER_WHEEL_SLOTS 64
+#endif
+
+#ifndef ASYNC_STACK_CLASSES
+    #define ASYNC_STACK_CLASSES 3
+#endif
+
+struct StackClass {
+    uint32_t stackSize;
+    uint8_t count;
+};
+
+enum class OverflowPolicy {
+    Block,
+    DropNewest,
+    DropOldest,
+    RunInline
+};
+
+enum class PendingPolicy {
+    Reject,
+    Block,
+    DropOldest
+};
+
+struct AsyncConfig {
+    uint32_t defaultStackSize = 4096;
+    UBaseType_t defaultPriority = 1;
+    BaseType_t defaultCore = tskNO_AFFINITY;
+    uint16_t maxConcurrentTasks = 10;
+    uint16_t pendingQueueSize = 16;
+    PendingPolicy pendingOverflow = PendingPolicy::Reject;
+    bool prioritizePending = false;
+    uint32_t cancelGraceMs = 200;
+    bool executeCallbacksInLoop = true;
+    uint8_t workersPerCore = 2;
+    uint16_t workerQueueSize = 32;
+    uint16_t callbackQueueSize = 64;
+    OverflowPolicy callbackOverflow = OverflowPolicy::Block;
+    uint16_t callbackAgingMs = 50;
+    bool callbackDispatcher = false;
+    BaseType_t dispatcherCore = 1;
+    UBaseType_t dispatcherPriority = 2;
+    uint32_t dispatcherStackSize = 4096;
+    uint16_t maxTimers = 32;
+    uint16_t timerResolutionMs = 10;
+    UBaseType_t timerPriority = 5;
+    uint32_t timerStackSize = 3072;
+    bool useStaticStacks = false;
+    StackClass stackClasses[ASYNC_STACK_CLASSES] = {{2048, 4}, {4096, 4}, {8192, 2}};
+    bool profileStacks = false;
+    bool useLearnedStacks = false;
+    uint16_t learnedStackMargin = 512;
+};
+
+enum class TaskState {
+    Pending,
+    Running,
+    Completed,
+    Failed,
+    Cancelled
+};
+
+template<typename T>
+class BoundedRing {
+public:
+    explicit BoundedRing(size_t requested) {
+        size_t cap = 2;
+        while (cap < requested) {
+            cap <<= 1;
+        }
+        mask = cap - 1;
+        cells = new Cell[cap];
+        for (size_t i = 0; i < cap; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~BoundedRing() {
+        delete[] cells;
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    bool tryPush(T&& value, size_t* ticket = nullptr) {
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        if (ticket) *ticket = pos;
+        return true;
+    }
+
+    bool tryPop(T& out, size_t* ticket = nullptr) {
+        Cell* cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        if (ticket) *ticket = pos;
+        return true;
+    }
+
+    size_t size() const {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell* cells;
+    size_t mask;
+    std::atomic<size_t> enqueuePos;
+    std::atomic<size_t> dequeuePos;
+};
+
+// Seqlock around a trivially copyable value: one task publishes, any number
+// of tasks read a consistent latest copy without taking a lock. The payload
+// is held as relaxed atomic words so concurrent copies stay well defined.
+template<typename T>
+class SharedState {
+    static_assert(std::is_trivially_copyable<T>::value, "SharedState requires a trivially copyable type");
+
+public:
+    SharedState() : SharedState(T()) {}
+
+    explicit SharedState(const T& initial) {
+        uint32_t buffer[Words] = {};
+        memcpy(buffer, &initial, sizeof(T));
+        for (size_t i = 0; i < Words; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+    }
+
+    SharedState(const SharedState&) = delete;
+    SharedState& operator=(const SharedState&) = delete;
+
+    // Only one task may publish at a time.
+    void publish(const T& value) {
+        uint32_t buffer[Words] = {};
+        memcpy(buffer, &value, sizeof(T));
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < Words; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Single attempt; fails if a publish was in progress.
+    bool tryLoad(T& out) const {
+        uint32_t buffer[Words];
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        for (size_t i = 0; i < Words; i++) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        memcpy(&out, buffer, sizeof(T));
+        return true;
+    }
+
+    // Retries until a consistent copy is read. After a few spins it sleeps a
+    // tick so a higher priority reader cannot starve a preempted writer.
+    T load() const {
+        T out;
+        uint32_t spins = 0;
+        while (!tryLoad(out)) {
+            if (++spins >= 8) {
+                vTaskDelay(1);
+                spins = 0;
+            }
+        }
+        return out;
+    }
+
+    // Copies the value only if it was published since `seen`, updating it.
+    bool loadIfChanged(T& out, uint32_t& seen) const {
+        uint32_t current = version();
+        if (current == seen) {
+            return false;
+        }
+        out = load();
+        seen = current;
+        return true;
+    }
+
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) >> 1;
+    }
+
+private:
+    static constexpr size_t Words = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> words[Words];
+};
+
+#ifdef ASYNC_LOG_DEFERRED
+
+#ifndef ASYNC_LOG_QUEUE_SIZE
+    #define ASYNC_LOG_QUEUE_SIZE 64
+#endif
+
+#ifndef ASYNC_LOG_FLUSH_MS
+    #define ASYNC_LOG_FLUSH_MS 20
+#endif
+
+// Deferred logger: callers only copy the format pointer and raw arguments into
+// a ring, a low-priority task does the formatting and the Serial write later.
+// Arguments are stored as 32-bit words, so they must be integers or enums of
+// at most 32 bits (cast wider values, and use %d/%u/%x rather than %ld/%lu).
+// At most one C string argument is allowed; it is copied (truncated) since it
+// may not outlive the call. The flushing task starts with Async::setConfig(),
+// so logging never creates a task from whatever context it is called in.
+class AsyncLog {
+public:
+    static AsyncLog& instance() {
+        static AsyncLog instance;
+        return instance;
+    }
+
+    template<typename... Args>
+    void write(const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) <= MaxArgs, "Deferred log records hold at most 4 arguments");
+        static_assert(stringCount<Args...>() <= 1, "Deferred log records hold at most one string");
+        Record record;
+        record.fmt = fmt;
+        uint8_t index = 0;
+        int expand[] = {0, (capture(record, index++, args), 0)...};
+        (void)expand;
+        if (!ring.tryPush(std::move(record))) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Each argument is passed back as the 32-bit word the format expects;
+    // the string, if any, goes in its own position as a pointer.
+    void flush() {
+        uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            Serial.printf("[EasyAsync][W] %u log records dropped\n", (unsigned)lost);
+        }
+        Record record;
+        while (ring.tryPop(record)) {
+            const uint32_t* a = record.args;
+            const char* t = record.text;
+            switch (record.stringArg) {
+                case 0:
+                    Serial.printf(record.fmt, t, a[1], a[2], a[3]);
+                    break;
+                case 1:
+                    Serial.printf(record.fmt, a[0], t, a[2], a[3]);
+                    break;
+                case 2:
+                    Serial.printf(record.fmt, a[0], a[1], t, a[3]);
+                    break;
+                case 3:
+                    Serial.printf(record.fmt, a[0], a[1], a[2], t);
+                    break;
+                default:
+                    Serial.printf(record.fmt, a[0], a[1], a[2], a[3]);
+                    break;
+            }
+        }
+    }
+
+    // Called from Async::setConfig(); later calls do nothing.
+    void startFlusher() {
+        if (starting.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        TaskHandle_t handle = nullptr;
+        if (xTaskCreate(&AsyncLog::flushLoop, "AsyncLog", 3072, this, 0, &handle) == pdPASS) {
+            flusher.store(handle, std::memory_order_release);
+        } else {
+            starting.store(false, std::memory_order_release);
+        }
+    }
+
+    uint32_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint8_t MaxArgs = 4;
+
+    struct Record {
+        const char* fmt = nullptr;
+        uint32_t args[MaxArgs] = {0, 0, 0, 0};
+        uint8_t stringArg = MaxArgs;
+        char text[16] = {0};
+    };
+
+    AsyncLog() : ring(ASYNC_LOG_QUEUE_SIZE) {}
+
+    template<typename T>
+    struct IsString {
+        static constexpr bool value = std::is_same<typename std::decay<T>::type, const char*>::value ||
+                                      std::is_same<typename std::decay<T>::type, char*>::value;
+    };
+
+    template<typename... Args>
+    static constexpr size_t stringCount() {
+        return countStrings(IsString<Args>::value...);
+    }
+
+    static constexpr size_t countStrings() {
+        return 0;
+    }
+
+    template<typename... Rest>
+    static constexpr size_t countStrings(bool first, Rest... rest) {
+        return (first ? 1 : 0) + countStrings(rest...);
+    }
+
+    template<typename T>
+    static void capture(Record& record, uint8_t index, T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "Deferred log arguments must be integers or enums");
+        static_assert(sizeof(T) <= sizeof(uint32_t), "Deferred log arguments must fit in 32 bits");
+        record.args[index] = (uint32_t)value;
+    }
+
+    static void capture(Record& record, uint8_t index, const char* value) {
+        record.stringArg = index;
+        strncpy(record.text, value ? value : "(null)", sizeof(record.text) - 1);
+    }
+
+    static void capture(Record& record, uint8_t index, char* value) {
+        capture(record, index, (const char*)value);
+    }
+
+    static void flushLoop(void* param) {
+        AsyncLog* self = static_cast<AsyncLog*>(param);
+        while (true) {
+            self->flush();
+            vTaskDelay(pdMS_TO_TICKS(ASYNC_LOG_FLUSH_MS));
+        }
+    }
+
+    BoundedRing<Record> ring;
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<bool> starting{false};
+    std::atomic<TaskHandle_t> flusher{nullptr};
+};
+
+#endif
+
+#ifdef ASYNC_TRACE
+
+#ifndef ASYNC_TRACE_EVENTS
+    #define ASYNC_TRACE_EVENTS 512
+#endif
+
+enum class TraceEvent : uint8_t {
+    Submit,
+    Run,
+    CallbackEnqueue,
+    CallbackRun
+};
+
+// Fixed-size trace ring; once full the oldest events are overwritten. Run
+// events are recorded when they end and carry their start time, so dump()
+// can emit complete ("X") slices per core plus async arrows from submit to
+// start and from callback enqueue to callback run.
+class AsyncTrace {
+public:
+    static AsyncTrace& instance() {
+        static AsyncTrace instance;
+        return instance;
+    }
+
+    void record(TraceEvent type, const char* name, uint32_t id, uint32_t startUs = 0) {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        uint32_t now = micros();
+        uint32_t index = next.fetch_add(1, std::memory_order_relaxed);
+        bool span = type == TraceEvent::Run || type == TraceEvent::CallbackRun;
+        Event e;
+        e.us = span ? startUs : now;
+        e.durUs = span ? now - startUs : 0;
+        e.id = id;
+        e.tid = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+        e.type = type;
+        e.core = (uint8_t)xPortGetCoreID();
+        copyName(e.name, name);
+        uint32_t buffer[Record::Words];
+        memcpy(buffer, &e, sizeof(e));
+
+        Record& r = records[index % ASYNC_TRACE_EVENTS];
+        r.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < Record::Words; i++) {
+            r.words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        r.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    void setEnabled(bool on) {
+        enabled.store(on, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < ASYNC_TRACE_EVENTS; i++) {
+            records[i].sequence.store(0, std::memory_order_relaxed);
+        }
+        next.store(0, std::memory_order_relaxed);
+    }
+
+    // Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Processes are
+    // cores, threads are FreeRTOS tasks.
+    void dump(Print& out) {
+        bool wasEnabled = enabled.exchange(false);
+        uint32_t end = next.load(std::memory_order_acquire);
+        uint32_t begin = end > ASYNC_TRACE_EVENTS ? end - ASYNC_TRACE_EVENTS : 0;
+
+        out.print("{\"traceEvents\":[");
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            out.printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                       core ? "," : "", core, core);
+        }
+        for (uint32_t i = begin; i < end; i++) {
+            Event r;
+            if (!records[i % ASYNC_TRACE_EVENTS].read(i + 1, r)) {
+                continue;
+            }
+            switch (r.type) {
+                case TraceEvent::Submit:
+                    writeAsync(out, r, "task", 'b', r.us);
+                    break;
+                case TraceEvent::Run:
+                    if (r.id != 0) writeAsync(out, r, "task", 'e', r.us);
+                    writeSpan(out, r, "task");
+                    break;
+                case TraceEvent::CallbackEnqueue:
+                    writeAsync(out, r, "callback", 'b', r.us);
+                    break;
+                case TraceEvent::CallbackRun:
+                    writeAsync(out, r, "callback", 'e', r.us);
+                    writeSpan(out, r, "callback");
+                    break;
+            }
+        }
+        out.print("]}\n");
+        enabled.store(wasEnabled);
+    }
+
+private:
+    struct Event {
+        uint32_t us = 0;
+        uint32_t durUs = 0;
+        uint32_t id = 0;
+        uint32_t tid = 0;
+        TraceEvent type = TraceEvent::Submit;
+        uint8_t core = 0;
+        char name[14] = {0};
+    };
+
+    // Seqlock around the event, as in SharedState: `sequence` is zero while
+    // a write is in progress and index + 1 once it is complete, so a dump
+    // racing record() drops the event instead of printing a torn one.
+    struct Record {
+        static constexpr size_t Words = (sizeof(Event) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+        bool read(uint32_t expected, Event& out) const {
+            if (sequence.load(std::memory_order_acquire) != expected) {
+                return false;
+            }
+            uint32_t buffer[Words];
+            for (size_t i = 0; i < Words; i++) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) != expected) {
+                return false;
+            }
+            memcpy(&out, buffer, sizeof(Event));
+            return true;
+        }
+
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint32_t> words[Words] = {};
+    };
+
+    AsyncTrace() {}
+
+    static void copyName(char* dst, const char* src) {
+        if (src == nullptr) src = "task";
+        size_t i = 0;
+        for (; i < sizeof(Event::name) - 1 && src[i]; i++) {
+            dst[i] = (src[i] == '"' || src[i] == '\\') ? '_' : src[i];
+        }
+        dst[i] = 0;
+    }
+
+    static void writeAsync(Print& out, const Event& r, const char* cat, char phase, uint32_t ts) {
+        out.printf(",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"id2\":{\"global\":\"%u\"},"
+                   "\"ts\":%u,\"pid\":%u,\"tid\":%u}",
+                   r.name, cat, phase, (unsigned)r.id, (unsigned)ts, (unsigned)r.core, (unsigned)r.tid);
+    }
+
+    static void writeSpan(Print& out, const Event& r, const char* cat) {
+        out.printf(",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,"
+                   "\"pid\":%u,\"tid\":%u}",
+                   r.name, cat, (unsigned)r.us, (unsigned)r.durUs, (unsigned)r.core, (unsigned)r.tid);
+    }
+
+    Record records[ASYNC_TRACE_EVENTS];
+    std::atomic<uint32_t> next{0};
+    std::atomic<bool> enabled{true};
+};
+
+#endif
+
+struct UpdateStats {
+    uint32_t processed;
+    size_t remaining;
+    uint32_t drainUs;
+    uint32_t maxDrainUs;
+};
+
+enum class CallbackPriority : uint8_t {
+    Low,
+    Normal,
+    High
+};
+
+#define ASYNC_CALLBACK_CLASSES 3
+
+struct CallbackClassStats {
+    uint16_t depth;
+    uint16_t peakDepth;
+    uint32_t processed;
+    uint32_t aged;
+    uint32_t averageWaitUs;
+    uint32_t maxWaitUs;
+};
+
+// One ring per priority class. process() serves the highest non-empty class,
+// except that a lower class left unserved for AsyncConfig::callbackAgingMs
+// goes first, so a flood of high-priority callbacks cannot starve the rest.
+class CallbackQueue {
+public:
+    static CallbackQueue& instance() {
+        static CallbackQueue instance;
+        return instance;
+    }
+
+    bool enqueue(CallbackFunction callback, CallbackPriority priority = CallbackPriority::Normal) {
+        uint8_t cls = (uint8_t)priority;
+        Class& c = classes[cls];
+        Entry entry{std::move(callback), (uint32_t)micros()};
+        size_t ticket = 0;
+        while (!c.ring->tryPush(std::move(entry), &ticket)) {
+            switch (policy.load(std::memory_order_relaxed)) {
+                case OverflowPolicy::DropNewest:
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    ASYNC_LOGW("Callback queue full, callback dropped");
+                    return false;
+                case OverflowPolicy::DropOldest: {
+                    Entry oldest;
+                    if (c.ring->tryPop(oldest)) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        ASYNC_LOGW("Callback queue full, oldest callback dropped");
+                    }
+                    break;
+                }
+                case OverflowPolicy::RunInline:
+                    overflowed.fetch_add(1, std::memory_order_relaxed);
+                    entry.fn();
+                    return true;
+                case OverflowPolicy::Block:
+                    overflowed.fetch_add(1, std::memory_order_relaxed);
+                    // The draining task would wait on itself: run it now.
+                    if (consumer.load(std::memory_order_acquire) == xTaskGetCurrentTaskHandle()) {
+                        entry.fn();
+                        return true;
+                    }
+                    if (!mayBlock()) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        ASYNC_LOGW("Callback queue full and cannot block, callback dropped");
+                        return false;
+                    }
+                    vTaskDelay(1);
+                    break;
+            }
+        }
+        size_t depth = c.ring->size();
+        if (depth == 1) {
+            c.lastServedUs.store(micros(), std::memory_order_relaxed);
+        }
+        uint16_t peak = c.peakDepth.load(std::memory_order_relaxed);
+        while (depth > peak &&
+               !c.peakDepth.compare_exchange_weak(peak, (uint16_t)depth, std::memory_order_relaxed)) {
+        }
+        ASYNC_TRACE_EVENT(TraceEvent::CallbackEnqueue, "callback", traceId(ticket, cls), 0);
+        ASYNC_LOGD("Callback enqueued. Queue size: %u", (unsigned)depth);
+        // Orders the push before the sleeper check; pairs with the fence in
+        // waitForWork() so either we see the sleeper or it sees the callback.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeper.load(std::memory_order_acquire) != nullptr) {
+            xSemaphoreGive(wakeSignal);
+        }
+        return true;
+    }
+
+    // Blocks the calling task until a callback is queued or ticks elapse.
+    // One task at a time sleeps on the queue's own semaphore, so the task's
+    // notification slots stay free for application code; any other caller
+    // polls. Stopping the dispatcher also ends the wait.
+    bool waitForWork(TickType_t ticks) {
+        if (size() > 0) {
+            return true;
+        }
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        TaskHandle_t expected = nullptr;
+        if (!sleeper.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+            TickType_t start = xTaskGetTickCount();
+            while (size() == 0 && !stopping.load(std::memory_order_acquire) &&
+                   (ticks == portMAX_DELAY || xTaskGetTickCount() - start < ticks)) {
+                vTaskDelay(1);
+            }
+            return size() > 0;
+        }
+        // Drop a wake left over from an earlier sleeper, then re-check after
+        // publishing ourselves so an enqueue in between cannot be missed.
+        xSemaphoreTake(wakeSignal, 0);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (size() == 0 && !stopping.load(std::memory_order_acquire)) {
+            xSemaphoreTake(wakeSignal, ticks);
+        }
+        sleeper.store(nullptr, std::memory_order_release);
+        return size() > 0;
+    }
+
+    // Starts the dispatcher task, or restarts it if it runs with different
+    // settings. Callbacks queued meanwhile wait for the new one.
+    bool startDispatcher(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (dispatching()) {
+            if (core == dispatcherCore && priority == dispatcherPriority &&
+                stackSize == dispatcherStackSize) {
+                return true;
+            }
+            if (!stopDispatcher()) {
+                return false;
+            }
+        }
+        stopping.store(false, std::memory_order_release);
+        TaskHandle_t task = nullptr;
+        BaseType_t result = xTaskCreatePinnedToCore(dispatchLoop, "AsyncDispatch", stackSize, this,
+                                                    priority, &task, core);
+        if (result != pdPASS) {
+            ASYNC_LOGE("Failed to create callback dispatcher");
+            return false;
+        }
+        dispatcherCore = core;
+        dispatcherPriority = priority;
+        dispatcherStackSize = stackSize;
+        dispatcher.store(task, std::memory_order_release);
+        ASYNC_LOGI("Callback dispatcher started on core %d", (int)core);
+        return true;
+    }
+
+    // Waits for the dispatcher to finish the callback it is running and
+    // exit; whatever is still queued is left for Async::update(). A callback
+    // cannot stop the dispatcher it runs on.
+    bool stopDispatcher() {
+        TaskHandle_t task = dispatcher.load(std::memory_order_acquire);
+        if (task == nullptr) {
+            return true;
+        }
+        if (task == xTaskGetCurrentTaskHandle()) {
+            ASYNC_LOGW("Callback dispatcher cannot stop itself");
+            return false;
+        }
+        stopping.store(true, std::memory_order_release);
+        xSemaphoreGive(wakeSignal);
+        while (dispatcher.load(std::memory_order_acquire) != nullptr) {
+            vTaskDelay(1);
+        }
+        ASYNC_LOGI("Callback dispatcher stopped");
+        return true;
+    }
+
+    // While the dispatcher task runs it owns the queue.
+    bool dispatching() const {
+        return dispatcher.load(std::memory_order_acquire) != nullptr;
+    }
+
+    // Runs queued callbacks until the queue is empty, maxCallbacks have run
+    // or maxMicros have elapsed (0 = no limit). At least one callback runs
+    // per call so a tiny budget still makes progress. Returns how many remain.
+    // Only one task drains at a time: a call made while another task is
+    // draining returns straight away. A callback may call it re-entrantly.
+    size_t process(uint32_t maxMicros = 0, uint32_t maxCallbacks = 0) {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        TaskHandle_t previous = nullptr;
+        if (!consumer.compare_exchange_strong(previous, self, std::memory_order_acq_rel) &&
+            previous != self) {
+            return size();
+        }
+        uint32_t startUs = micros();
+        uint32_t processed = 0;
+        Entry entry;
+        size_t ticket = 0;
+        uint8_t cls = 0;
+        while ((maxCallbacks == 0 || processed < maxCallbacks) && popNext(entry, ticket, cls)) {
+            ASYNC_LOGD("Processing callback...");
+            uint32_t callbackUs = micros();
+            Class& c = classes[cls];
+            uint32_t waitUs = callbackUs - entry.enqueuedUs;
+            c.totalWaitUs += waitUs;
+            if (waitUs > c.maxWaitUs) {
+                c.maxWaitUs = waitUs;
+            }
+            c.processed++;
+            entry.fn();
+            entry.fn = nullptr;
+            ASYNC_TRACE_EVENT(TraceEvent::CallbackRun, "callback", traceId(ticket, cls), callbackUs);
+            processed++;
+            if (maxMicros > 0 && micros() - startUs >= maxMicros) {
+                break;
+            }
+        }
+
+        size_t remaining = size();
+        uint32_t drainUs = micros() - startUs;
+        last.processed = processed;
+        last.remaining = remaining;
+        last.drainUs = drainUs;
+        if (drainUs > last.maxDrainUs) {
+            last.maxDrainUs = drainUs;
+        }
+        if (previous == nullptr) {
+            consumer.store(nullptr, std::memory_order_release);
+        }
+        return remaining;
+    }
+
+    // Picks up the overflow policy and aging window from a new config; the
+    // ring sizes stay as first configured.
+    void configure(const AsyncConfig& config) {
+        policy.store(config.callbackOverflow, std::memory_order_relaxed);
+        agingUs.store((uint32_t)config.callbackAgingMs * 1000, std::memory_order_relaxed);
+    }
+
+    // Written by whichever task drains the queue, normally loop().
+    const UpdateStats& lastUpdate() const {
+        return last;
+    }
+
+    CallbackClassStats classStats(CallbackPriority priority) const {
+        const Class& c = classes[(uint8_t)priority];
+        return CallbackClassStats{
+            (uint16_t)c.ring->size(),
+            c.peakDepth.load(std::memory_order_relaxed),
+            c.processed,
+            c.aged,
+            c.processed > 0 ? (uint32_t)(c.totalWaitUs / c.processed) : 0,
+            c.maxWaitUs};
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Class& c : classes) {
+            total += c.ring->size();
+        }
+        return total;
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Class& c : classes) {
+            total += c.ring->capacity();
+        }
+        return total;
+    }
+
+    uint32_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    uint32_t overflowCount() const {
+        return overflowed.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        CallbackFunction fn;
+        uint32_t enqueuedUs;
+    };
+
+    struct Class {
+        BoundedRing<Entry>* ring = nullptr;
+        std::atomic<uint32_t> lastServedUs{0};
+        std::atomic<uint16_t> peakDepth{0};
+        uint32_t processed = 0;
+        uint32_t aged = 0;
+        uint64_t totalWaitUs = 0;
+        uint32_t maxWaitUs = 0;
+    };
+
+    CallbackQueue() : wakeSignal(xSemaphoreCreateBinaryStatic(&wakeSignalBuffer)) {
+        extern AsyncConfig globalConfig;
+        configure(globalConfig);
+        for (Class& c : classes) {
+            c.ring = new BoundedRing<Entry>(globalConfig.callbackQueueSize);
+        }
+    }
+
+    static void dispatchLoop(void* param) {
+        CallbackQueue* self = static_cast<CallbackQueue*>(param);
+        while (!self->stopping.load(std::memory_order_acquire)) {
+            if (self->waitForWork(portMAX_DELAY)) {
+                self->process();
+            }
+        }
+        self->stopping.store(false, std::memory_order_relaxed);
+        self->dispatcher.store(nullptr, std::memory_order_release);
+        vTaskDelete(NULL);
+    }
+
+    // Blocking is only safe when someone else drains the queue: never on
+    // the timer task, and never when nothing runs process() at all.
+    bool mayBlock() const;
+
+    static uint32_t traceId(size_t ticket, uint8_t cls) {
+        return (uint32_t)(ticket * ASYNC_CALLBACK_CLASSES + cls) + 1;
+    }
+
+    bool popNext(Entry& out, size_t& ticket, uint8_t& cls) {
+        uint32_t now = micros();
+        uint32_t aging = agingUs.load(std::memory_order_relaxed);
+        if (aging > 0) {
+            for (uint8_t i = 0; i + 1 < ASYNC_CALLBACK_CLASSES; i++) {
+                Class& c = classes[i];
+                if (c.ring->size() > 0 &&
+                    now - c.lastServedUs.load(std::memory_order_relaxed) >= aging &&
+                    c.ring->tryPop(out, &ticket)) {
+                    c.aged++;
+                    c.lastServedUs.store(now, std::memory_order_relaxed);
+                    cls = i;
+                    return true;
+                }
+            }
+        }
+        for (int i = ASYNC_CALLBACK_CLASSES - 1; i >= 0; i--) {
+            Class& c = classes[i];
+            if (c.ring->tryPop(out, &ticket)) {
+                c.lastServedUs.store(now, std::memory_order_relaxed);
+                cls = (uint8_t)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Class classes[ASYNC_CALLBACK_CLASSES];
+    std::atomic<OverflowPolicy> policy{OverflowPolicy::Block};
+    std::atomic<uint32_t> agingUs{0};
+    UpdateStats last = {};
+    StaticSemaphore_t wakeSignalBuffer;
+    SemaphoreHandle_t wakeSignal;
+    std::atomic<TaskHandle_t> sleeper{nullptr};
+    std::atomic<TaskHandle_t> consumer{nullptr};
+    std::atomic<TaskHandle_t> dispatcher{nullptr};
+    std::atomic<bool> stopping{false};
+    BaseType_t dispatcherCore = 0;
+    UBaseType_t dispatcherPriority = 0;
+    uint32_t dispatcherStackSize = 0;
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> overflowed{0};
+};
+
+enum class ChannelMode : uint8_t {
+    SPSC,
+    MPMC
+};
+
+template<typename T, size_t N, ChannelMode Mode>
+class ChannelStorage;
+
+// One producer and one consumer: plain head/tail counters, and batches
+// publish with a single store.
+template<typename T, size_t N>
+class ChannelStorage<T, N, ChannelMode::SPSC> {
+public:
+    size_t tryPush(T* items, size_t count) {
+        size_t tail = tailPos.load(std::memory_order_relaxed);
+        size_t space = N - (tail - headPos.load(std::memory_order_acquire));
+        size_t n = count < space ? count : space;
+        for (size_t i = 0; i < n; i++) {
+            slots[(tail + i) % N] = std::move(items[i]);
+        }
+        tailPos.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t tryPop(T* out, size_t count) {
+        size_t head = headPos.load(std::memory_order_relaxed);
+        size_t available = tailPos.load(std::memory_order_acquire) - head;
+        size_t n = count < available ? count : available;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = std::move(slots[(head + i) % N]);
+            slots[(head + i) % N] = T();
+        }
+        headPos.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const {
+        size_t head = headPos.load(std::memory_order_acquire);
+        return tailPos.load(std::memory_order_acquire) - head;
+    }
+
+private:
+    T slots[N];
+    std::atomic<size_t> headPos{0};
+    std::atomic<size_t> tailPos{0};
+};
+
+// Any number of producers and consumers: the BoundedRing algorithm over
+// inline cells.
+template<typename T, size_t N>
+class ChannelStorage<T, N, ChannelMode::MPMC> {
+public:
+    ChannelStorage() {
+        for (size_t i = 0; i < N; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t tryPush(T* items, size_t count) {
+        size_t n = 0;
+        while (n < count && pushOne(items[n])) {
+            n++;
+        }
+        return n;
+    }
+
+    size_t tryPop(T* out, size_t count) {
+        size_t n = 0;
+        while (n < count && popOne(out[n])) {
+            n++;
+        }
+        return n;
+    }
+
+    size_t size() const {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    bool pushOne(T& value) {
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos % N];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool popOne(T& out) {
+        Cell* cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos % N];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell cells[N];
+    std::atomic<size_t> enqueuePos{0};
+    std::atomic<size_t> dequeuePos{0};
+};
+
+// Bounded typed stream between tasks. Sends and receives are lock-free while
+// the channel is neither full nor empty; only then do callers block on a
+// semaphore. Timeouts are in milliseconds, portMAX_DELAY waits forever.
+template<typename T, size_t N, ChannelMode Mode = ChannelMode::MPMC>
+class Channel {
+    static_assert(N > 0, "Channel capacity must be non-zero");
+
+public:
+    Channel() {
+        itemSignal = xSemaphoreCreateCountingStatic(N, 0, &itemSignalBuffer);
+        spaceSignal = xSemaphoreCreateCountingStatic(N, 0, &spaceSignalBuffer);
+    }
+
+    // A notification still queued or running when the channel goes away
+    // finds it detached and does nothing. If the notifier is running on
+    // another task, this waits for it to return first.
+    ~Channel() {
+        if (link) {
+            if (link->runner.load(std::memory_order_acquire) == xTaskGetCurrentTaskHandle()) {
+                link->channel = nullptr;
+            } else {
+                xSemaphoreTake(link->lock, portMAX_DELAY);
+                link->channel = nullptr;
+                xSemaphoreGive(link->lock);
+            }
+        }
+        vSemaphoreDelete(itemSignal);
+        vSemaphoreDelete(spaceSignal);
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    bool trySend(const T& value) {
+        T copy = value;
+        return sendN(&copy, 1, 0) == 1;
+    }
+
+    bool trySend(T&& value) {
+        return sendN(&value, 1, 0) == 1;
+    }
+
+    bool send(const T& value, uint32_t timeoutMs = portMAX_DELAY) {
+        T copy = value;
+        return sendN(&copy, 1, timeoutMs) == 1;
+    }
+
+    bool send(T&& value, uint32_t timeoutMs = portMAX_DELAY) {
+        return sendN(&value, 1, timeoutMs) == 1;
+    }
+
+    bool tryReceive(T& out) {
+        return receiveN(&out, 1, 0) == 1;
+    }
+
+    bool receive(T& out, uint32_t timeoutMs = portMAX_DELAY) {
+        return receiveN(&out, 1, timeoutMs) == 1;
+    }
+
+    // Moves items in until all are sent or the timeout expires; returns how
+    // many were sent. Items that were not sent are left untouched.
+    size_t sendN(T* items, size_t count, uint32_t timeoutMs = portMAX_DELAY) {
+        size_t sent = 0;
+        Deadline deadline(timeoutMs);
+        while (true) {
+            size_t n = storage.tryPush(items + sent, count - sent);
+            if (n > 0) {
+                sent += n;
+                wake(itemSignal, receiversWaiting, n);
+                notify();
+            }
+            if (sent == count) {
+                return sent;
+            }
+            if (!waitFor(spaceSignal, sendersWaiting, deadline, [this]() {
+                    return storage.size() < N;
+                })) {
+                return sent;
+            }
+        }
+    }
+
+    // Waits for at least one item, then takes whatever else is already
+    // queued up to `max` without blocking again.
+    size_t receiveN(T* out, size_t max, uint32_t timeoutMs = portMAX_DELAY) {
+        Deadline deadline(timeoutMs);
+        while (true) {
+            size_t n = storage.tryPop(out, max);
+            if (n > 0) {
+                wake(spaceSignal, sendersWaiting, n);
+                return n;
+            }
+            if (max == 0 || !waitFor(itemSignal, receiversWaiting, deadline, [this]() {
+                    return storage.size() > 0;
+                })) {
+                return 0;
+            }
+        }
+    }
+
+    // Queues `callback` on the CallbackQueue when items arrive, so a consumer
+    // driven by Async::update() or the dispatcher task drains the channel
+    // instead of polling. At most one notification is outstanding; sends made
+    // while it runs queue another. Set it before producers start.
+    void onAvailable(CallbackFunction callback, CallbackPriority priority = CallbackPriority::Normal) {
+        if (!link) {
+            link = std::make_shared<NotifyLink>(this);
+        }
+        link->notifier = std::move(callback);
+        notifyPriority = priority;
+        hasNotifier.store((bool)link->notifier, std::memory_order_release);
+    }
+
+    size_t size() const {
+        return storage.size();
+    }
+
+    bool empty() const {
+        return storage.size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    struct Deadline {
+        explicit Deadline(uint32_t timeoutMs)
+            : forever(timeoutMs == portMAX_DELAY), start(xTaskGetTickCount()),
+              ticks(forever ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs)) {}
+
+        TickType_t remaining() const {
+            if (forever) {
+                return portMAX_DELAY;
+            }
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            return elapsed >= ticks ? 0 : ticks - elapsed;
+        }
+
+        bool forever;
+        TickType_t start;
+        TickType_t ticks;
+    };
+
+    // Announces the waiter before re-checking `ready`, so a wake issued
+    // between the failed attempt and the take is never lost. Extra counts on
+    // the semaphore only cause a spurious retry.
+    template<typename Ready>
+    bool waitFor(SemaphoreHandle_t signal, std::atomic<uint32_t>& waiters, const Deadline& deadline,
+                 Ready ready) {
+        TickType_t ticks = deadline.remaining();
+        if (ticks == 0) {
+            return false;
+        }
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool woke = ready() || xSemaphoreTake(signal, ticks) == pdTRUE;
+        waiters.fetch_sub(1, std::memory_order_seq_cst);
+        return woke || ready();
+    }
+
+    static void wake(SemaphoreHandle_t signal, std::atomic<uint32_t>& waiters, size_t count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t waiting = waiters.load(std::memory_order_seq_cst);
+        for (size_t i = 0; i < count && i < waiting; i++) {
+            xSemaphoreGive(signal);
+        }
+    }
+
+    // Shared with queued notifications, so they can outlive the channel. The
+    // notifier lives here rather than in the channel so it survives a
+    // notifier that destroys its own channel.
+    struct NotifyLink {
+        explicit NotifyLink(Channel* owner) : lock(xSemaphoreCreateMutex()), channel(owner) {}
+        ~NotifyLink() {
+            vSemaphoreDelete(lock);
+        }
+
+        SemaphoreHandle_t lock;
+        Channel* channel;
+        CallbackFunction notifier;
+        std::atomic<TaskHandle_t> runner{nullptr};
+    };
+
+    static void deliver(NotifyLink& link) {
+        xSemaphoreTake(link.lock, portMAX_DELAY);
+        if (Channel* channel = link.channel) {
+            link.runner.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+            channel->notifyPending.store(false, std::memory_order_release);
+            link.notifier();
+            link.runner.store(nullptr, std::memory_order_release);
+        }
+        xSemaphoreGive(link.lock);
+    }
+
+    void notify() {
+        if (!hasNotifier.load(std::memory_order_acquire) ||
+            notifyPending.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        std::shared_ptr<NotifyLink> target = link;
+        if (!CallbackQueue::instance().enqueue([target]() { deliver(*target); }, notifyPriority)) {
+            notifyPending.store(false, std::memory_order_release);
+        }
+    }
+
+    ChannelStorage<T, N, Mode> storage;
+    StaticSemaphore_t itemSignalBuffer;
+    StaticSemaphore_t spaceSignalBuffer;
+    SemaphoreHandle_t itemSignal = nullptr;
+    SemaphoreHandle_t spaceSignal = nullptr;
+    std::atomic<uint32_t> sendersWaiting{0};
+    std::atomic<uint32_t> receiversWaiting{0};
+    std::shared_ptr<NotifyLink> link;
+    CallbackPriority notifyPriority = CallbackPriority::Normal;
+    std::atomic<bool> hasNotifier{false};
+    std::atomic<bool> notifyPending{false};
+};
+
+struct TaskConfig {
+    uint32_t stackSize = 0;
+    UBaseType_t priority = 0;
+    BaseType_t core = tskNO_AFFINITY;
+    const char* name = nullptr;
+    uint32_t timeoutMs = 0;
+    bool failOnTimeout = false;
+    bool executeInLoop = true;
+    bool dedicated = false;
+    CallbackPriority callbackPriority = CallbackPriority::Normal;
+};
+
+class TaskHandle;
+
+typedef uint32_t TimerId;
+
+class TimerService {
+public:
+    using Launcher = bool (*)(TaskFunction&, TaskConfig&, const std::shared_ptr<TaskHandle>&);
+
+    static TimerService& instance() {
+        static TimerService instance;
+        return instance;
+    }
+
+    // Caller-owned timer for when the record pool is exhausted, e.g. inside
+    // a coroutine frame. Waiters sit on one list the timer task scans every
+    // step and cannot be cancelled; fire() must not touch the waiter after
+    // handing control to whoever frees it.
+    struct Waiter {
+        TickType_t due = 0;
+        Waiter* next = nullptr;
+        void (*fire)(void*) = nullptr;
+        void* context = nullptr;
+    };
+
+    TimerId schedule(uint32_t delayMs, TaskFunction& func) {
+        return schedule(delayMs, func, nullptr, TaskConfig(), nullptr);
+    }
+
+    // Returns false only if there is no timer task to fire the waiter.
+    bool schedule(uint32_t delayMs, Waiter& waiter) {
+        if (timerTask == nullptr) {
+            return false;
+        }
+        portENTER_CRITICAL(&lock);
+        waiter.due = xTaskGetTickCount() + ticksFor(delayMs);
+        waiter.next = waiters;
+        waiters = &waiter;
+        bool wasIdle = armedCount == 0 && waiter.next == nullptr;
+        portEXIT_CRITICAL(&lock);
+
+        if (wasIdle) {
+            xSemaphoreGive(wakeSignal);
+        }
+        return true;
+    }
+
+    TimerId schedule(uint32_t delayMs, TaskFunction& func, Launcher launcher,
+                     const TaskConfig& config, const std::shared_ptr<TaskHandle>& task) {
+        if (timerTask == nullptr) {
+            return 0;
+        }
+
+        portENTER_CRITICAL(&lock);
+        Record* record = freeList;
+        if (record != nullptr) {
+            freeList = record->next;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        if (record == nullptr) {
+            exhausted.fetch_add(1, std::memory_order_relaxed);
+            ASYNC_LOGW("Timer pool exhausted");
+            return 0;
+        }
+
+        record->func = std::move(func);
+        record->launcher = launcher;
+        record->config = config;
+        record->task = task;
+
+        TickType_t ticks = ticksFor(delayMs);
+
+        portENTER_CRITICAL(&lock);
+        record->due = xTaskGetTickCount() + ticks;
+        place(record, ticks);
+        TimerId id = idOf(record);
+        bool wasIdle = armedCount++ == 0;
+        portEXIT_CRITICAL(&lock);
+
+        if (wasIdle) {
+            xSemaphoreGive(wakeSignal);
+        }
+        return id;
+    }
+
+    bool cancel(TimerId id) {
+        if (id == 0) {
+            return false;
+        }
+        uint16_t index = (id & 0xFFFF) - 1;
+        if (index >= recordCount) {
+            return false;
+        }
+
+        Record* record = &records[index];
+        portENTER_CRITICAL(&lock);
+        bool found = record->armed && idOf(record) == id;
+        if (found) {
+            unlink(record);
+            armedCount--;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        if (found) {
+            recycle(record);
+        }
+        return found;
+    }
+
+    size_t pending() const {
+        portENTER_CRITICAL(&lock);
+        size_t count = armedCount;
+        portEXIT_CRITICAL(&lock);
+        return count;
+    }
+
+    uint32_t exhaustedCount() const {
+        return exhausted.load(std::memory_order_relaxed);
+    }
+
+    bool onTimerTask() const {
+        return timerTask != nullptr && xTaskGetCurrentTaskHandle() == timerTask;
+    }
+
+private:
+    struct Record {
+        TaskFunction func;
+        Launcher launcher = nullptr;
+        TaskConfig config;
+        std::shared_ptr<TaskHandle> task;
+        Record* prev = nullptr;
+        Record* next = nullptr;
+        TickType_t due = 0;
+        uint32_t rounds = 0;
+        uint16_t bucket = 0;
+        uint16_t generation = 0;
+        bool armed = false;
+    };
+
+    static_assert((ASYNC_TIMER_WHEEL_SLOTS & (ASYNC_TIMER_WHEEL_SLOTS - 1)) == 0,
+                  "ASYNC_TIMER_WHEEL_SLOTS must be a power of two");
+
+    Record* wheel[ASYNC_TIMER_WHEEL_SLOTS] = {};
+    Record* records = nullptr;
+    Record* freeList = nullptr;
+    uint16_t recordCount = 0;
+    uint32_t cursor = 0;
+    size_t armedCount = 0;
+    TickType_t tickPeriod = 1;
+    Waiter* waiters = nullptr;
+    TaskHandle_t timerTask = nullptr;
+    // Wakes the idle timer task. A semaphore rather than a task notification,
+    // so a timer callback waiting on its own notification can neither
+    // swallow a wake-up nor be woken by one.
+    StaticSemaphore_t wakeSignalBuffer;
+    SemaphoreHandle_t wakeSignal = nullptr;
+    std::atomic<uint32_t> exhausted{0};
+    mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    TimerService() {
+        extern AsyncConfig globalConfig;
+        tickPeriod = pdMS_TO_TICKS(globalConfig.timerResolutionMs) > 0
+                         ? pdMS_TO_TICKS(globalConfig.timerResolutionMs)
+                         : 1;
+        recordCount = globalConfig.maxTimers;
+        records = new Record[recordCount];
+        for (uint16_t i = 0; i < recordCount; i++) {
+            records[i].next = freeList;
+            freeList = &records[i];
+        }
+
+        wakeSignal = xSemaphoreCreateBinaryStatic(&wakeSignalBuffer);
+        if (xTaskCreate(timerLoop, "AsyncTimer", globalConfig.timerStackSize, this,
+                        globalConfig.timerPriority, &timerTask) != pdPASS) {
+            timerTask = nullptr;
+            ASYNC_LOGE("Failed to create timer task");
+        }
+    }
+
+    // The delay is a minimum: round up to whole kernel ticks, plus one
+    // because the current tick may be about to end.
+    static TickType_t ticksFor(uint32_t delayMs) {
+        return (TickType_t)(((uint64_t)delayMs * configTICK_RATE_HZ + 999) / 1000) + 1;
+    }
+
+    TimerId idOf(const Record* record) const {
+        return ((TimerId)record->generation << 16) | (TimerId)(record - records + 1);
+    }
+
+    void link(Record* record, uint32_t bucket) {
+        record->bucket = bucket;
+        record->prev = nullptr;
+        record->next = wheel[bucket];
+        if (record->next != nullptr) {
+            record->next->prev = record;
+        }
+        wheel[bucket] = record;
+        record->armed = true;
+    }
+
+    // Links the record into the bucket `ticks` from the cursor, rounded up
+    // to whole wheel steps. Caller holds the lock.
+    void place(Record* record, TickType_t ticks) {
+        uint32_t steps = (ticks + tickPeriod - 1) / tickPeriod;
+        if (steps == 0) {
+            steps = 1;
+        }
+        record->rounds = (steps - 1) / ASYNC_TIMER_WHEEL_SLOTS;
+        link(record, (cursor + steps) & (ASYNC_TIMER_WHEEL_SLOTS - 1));
+    }
+
+    void unlink(Record* record) {
+        if (record->prev != nullptr) {
+            record->prev->next = record->next;
+        } else {
+            wheel[record->bucket] = record->next;
+        }
+        if (record->next != nullptr) {
+            record->next->prev = record->prev;
+        }
+        record->prev = nullptr;
+        record->next = nullptr;
+        record->armed = false;
+    }
+
+    void recycle(Record* record) {
+        record->func = nullptr;
+        record->task.reset();
+        portENTER_CRITICAL(&lock);
+        record->generation++;
+        record->next = freeList;
+        freeList = record;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    // Records reaching their bucket fire only once their absolute deadline
+    // has passed; one slotted from part way through a step is moved on.
+    void advance() {
+        Record* due = nullptr;
+        TickType_t now = xTaskGetTickCount();
+        portENTER_CRITICAL(&lock);
+        cursor = (cursor + 1) & (ASYNC_TIMER_WHEEL_SLOTS - 1);
+        Record* record = wheel[cursor];
+        while (record != nullptr) {
+            Record* next = record->next;
+            if (record->rounds > 0) {
+                record->rounds--;
+            } else if ((int32_t)(record->due - now) > 0) {
+                unlink(record);
+                place(record, record->due - now);
+            } else {
+                unlink(record);
+                armedCount--;
+                record->next = due;
+                due = record;
+            }
+            record = next;
+        }
+        Waiter* expired = nullptr;
+        for (Waiter** link = &waiters; *link != nullptr;) {
+            Waiter* waiter = *link;
+            if ((int32_t)(waiter->due - now) > 0) {
+                link = &waiter->next;
+                continue;
+            }
+            *link = waiter->next;
+            waiter->next = expired;
+            expired = waiter;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        while (due != nullptr) {
+            Record* next = due->next;
+            fire(due);
+            due = next;
+        }
+        while (expired != nullptr) {
+            Waiter* next = expired->next;
+            expired->fire(expired->context);
+            expired = next;
+        }
+    }
+
+    void fire(Record* record) {
+        TaskFunction func = std::move(record->func);
+        Launcher launcher = record->launcher;
+        TaskConfig config = record->config;
+        std::shared_ptr<TaskHandle> task = std::move(record->task);
+        recycle(record);
+
+        try {
+            if (launcher != nullptr) {
+                launcher(func, config, task);
+            } else {
+                func();
+            }
+        } catch (...) {
+            ASYNC_LOGE("Exception in timer callback");
+        }
+    }
+
+    static void timerLoop(void* param) {
+        auto* self = static_cast<TimerService*>(param);
+        TickType_t lastWake = xTaskGetTickCount();
+        while (true) {
+            portENTER_CRITICAL(&self->lock);
+            bool idle = self->armedCount == 0 && self->waiters == nullptr;
+            portEXIT_CRITICAL(&self->lock);
+
+            if (idle) {
+                xSemaphoreTake(self->wakeSignal, portMAX_DELAY);
+                lastWake = xTaskGetTickCount();
+                continue;
+            }
+            vTaskDelayUntil(&lastWake, self->tickPeriod);
+            self->advance();
+        }
+    }
+};
+
+inline bool CallbackQueue::mayBlock() const {
+    extern AsyncConfig globalConfig;
+    if (!globalConfig.executeCallbacksInLoop && !dispatching()) {
+        return false;
+    }
+    return !TimerService::instance().onTimerTask();
+}
+
+struct PeriodicStats {
+    uint32_t periodUs = 0;
+    uint32_t runs = 0;
+    uint32_t overruns = 0;
+    uint32_t missedPeriods = 0;
+    uint32_t lastExecUs = 0;
+    uint32_t maxExecUs = 0;
+    uint64_t totalExecUs = 0;
+    int32_t lastJitterUs = 0;
+    uint32_t maxJitterUs = 0;
+    uint64_t totalJitterUs = 0;
+
+    uint32_t averageExecUs() const {
+        return runs > 0 ? (uint32_t)(totalExecUs / runs) : 0;
+    }
+
+    uint32_t averageJitterUs() const {
+        return runs > 0 ? (uint32_t)(totalJitterUs / runs) : 0;
+    }
+
+    void record(uint32_t execUs, int32_t jitterUs) {
+        uint32_t absJitter = jitterUs < 0 ? (uint32_t)-jitterUs : (uint32_t)jitterUs;
+        runs++;
+        lastExecUs = execUs;
+        totalExecUs += execUs;
+        if (execUs > maxExecUs) {
+            maxExecUs = execUs;
+        }
+        lastJitterUs = jitterUs;
+        totalJitterUs += absJitter;
+        if (absJitter > maxJitterUs) {
+            maxJitterUs = absJitter;
+        }
+    }
+};
+
+class TaskHandle : public std::enable_shared_from_this<TaskHandle> {
+public:
+    TaskHandle() : taskHandle(nullptr), state((uint8_t)TaskState::Pending), 
+                   cancelled(false), startTime(0), endTime(0), timerId(0) {}
+
+    ~TaskHandle() {
+        delete timeoutCallback.exchange(nullptr);
+        CancelCallback* node = cancelCallbacks.exchange(nullptr);
+        while (node != nullptr) {
+            CancelCallback* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    TaskHandle(const TaskHandle&) = delete;
+    TaskHandle& operator=(const TaskHandle&) = delete;
+
+    // A cancel that arrived before the handle was known could not schedule
+    // the hard kill, so it is picked up here.
+    void setHandle(TaskHandle_t handle) { 
+        taskHandle.store(handle, std::memory_order_seq_cst); 
+        killIfStuck();
+    }
+
+    // The future this task resolves, failed as soon as the task is cancelled
+    // or times out rather than when (or if) its body returns.
+    void bindFuture(const std::shared_ptr<void>& state, void (*fail)(void*)) {
+        future = state;
+        failFuture = fail;
+    }
+
+    // How a hard kill frees what the deleted task owned. The hook runs once
+    // the task is suspended and off every core, and deletes it or hands it
+    // to whoever will.
+    void setReclaim(void (*fn)(void*, TaskHandle_t), void* arg) {
+        reclaimFn = fn;
+        reclaimArg = arg;
+    }
+
+    void setTimer(TimerId id) {
+        timerId.store(id, std::memory_order_release);
+    }
+
+    void enablePeriodic(uint32_t periodUs) {
+        PeriodicStats initial;
+        initial.periodUs = periodUs;
+        periodic.reset(new SharedState<PeriodicStats>(initial));
+        cooperative = true;
+    }
+
+    SharedState<PeriodicStats>* periodicStats() const { return periodic.get(); }
+
+    void setName(const char* taskName) {
+        name = taskName;
+    }
+
+    const char* getName() const { return name; }
+
+    // Pending -> Running. Fails if the task already reached a final state,
+    // in which case its body must not run.
+    bool markStarted() {
+        uint8_t expected = (uint8_t)TaskState::Pending;
+        if (!state.compare_exchange_strong(expected, (uint8_t)TaskState::Running,
+                                           std::memory_order_acq_rel)) {
+            return false;
+        }
+        uint32_t now = millis();
+        startTime.store(now, std::memory_order_relaxed);
+        body.store(BodyRunning, std::memory_order_seq_cst);
+        killIfStuck();
+#ifdef ASYNC_TRACE
+        traceStartUs.store(micros(), std::memory_order_relaxed);
+#endif
+        ASYNC_LOGD("Task started at %u ms", (unsigned)now);
+        if (timeoutMs > 0 && !periodic) {
+            armWatchdog();
+        }
+        return true;
+    }
+
+    // Called by the task as soon as its body returns. If a hard kill already
+    // claimed the task it parks here until the deletion lands. A task that
+    // timed out or was cancelled while running gives up its admission slot
+    // here, once its worker or stack is actually free again.
+    void finishRun() {
+        uint8_t expected = BodyRunning;
+        if (!body.compare_exchange_strong(expected, BodyIdle, std::memory_order_seq_cst) &&
+            expected == BodyKilled) {
+            while (true) {
+                vTaskDelay(portMAX_DELAY);
+            }
+        }
+        if (isFinal((TaskState)state.load(std::memory_order_seq_cst))) {
+            releaseSlot();
+        }
+        TimerId id = watchdogId.exchange(0, std::memory_order_acq_rel);
+        if (id != 0) {
+            TimerService::instance().cancel(id);
+        }
+    }
+
+    void setTimeout(uint32_t ms, bool fail, bool inLoop) {
+        timeoutMs = ms;
+        failOnTimeout = fail;
+        timeoutInLoop = inLoop;
+    }
+
+    void onTimeout(CallbackFunction fn) {
+        delete timeoutCallback.exchange(new CallbackFunction(std::move(fn)));
+    }
+
+    bool timedOut() const { return expired.load(std::memory_order_relaxed); }
+
+    static uint32_t timeoutCount() { return timeouts().load(std::memory_order_relaxed); }
+
+    TaskHandle_t getHandle() const { return taskHandle.load(std::memory_order_acquire); }
+    
+    TaskState getState() const { return (TaskState)state.load(std::memory_order_acquire); }
+    
+    // Compare-and-swap transition; returns false if it lost. Final states
+    // are never left, so when cancellation, a timeout and completion race
+    // exactly one of them wins and only the winner runs the completion path.
+    bool setState(TaskState newState) { 
+        uint8_t current = state.load(std::memory_order_acquire);
+        do {
+            if (isFinal((TaskState)current) || current == (uint8_t)newState) {
+                return false;
+            }
+        } while (!state.compare_exchange_weak(current, (uint8_t)newState, std::memory_order_seq_cst,
+                                              std::memory_order_acquire));
+        if (isFinal(newState)) {
+            uint32_t now = millis();
+            endTime.store(now, std::memory_order_relaxed);
+            // Pairs with finishRun(): whichever of the two runs last sees
+            // the other's store and releases the slot.
+            if (body.load(std::memory_order_seq_cst) != BodyRunning) {
+                releaseSlot();
+            }
+#ifdef ASYNC_TRACE
+            uint32_t started = traceStartUs.exchange(0, std::memory_order_relaxed);
+            if (started != 0 && !periodic) {
+                ASYNC_TRACE_EVENT(TraceEvent::Run, name, traceId(), started);
+            }
+#endif
+            ASYNC_LOGD("Task ended at %u ms. Duration: %u ms", (unsigned)now,
+                       (unsigned)(now - startTime.load(std::memory_order_relaxed)));
+        }
+        return true;
+    }
+
+    bool isCancelled() const { return cancelled.load(std::memory_order_acquire); }
+    
+    // Requests cancellation. Running tasks observe it through their token and
+    // report Cancelled when they return; a dedicated task that is still
+    // running after AsyncConfig::cancelGraceMs is deleted as a last resort.
+    void cancel() {
+        if (cancelled.exchange(true, std::memory_order_seq_cst)) {
+            return;
+        }
+        runCancelCallbacks();
+        if (failFuture != nullptr) {
+            if (std::shared_ptr<void> bound = future.lock()) {
+                failFuture(bound.get());
+            }
+        }
+        TaskState current = getState();
+        TimerId timer = timerId.load(std::memory_order_acquire);
+        if (current == TaskState::Pending && timer != 0 && TimerService::instance().cancel(timer)) {
+            setState(TaskState::Cancelled);
+            ASYNC_LOGI("Delayed task cancelled");
+        } else if (current == TaskState::Running) {
+            killIfStuck();
+            ASYNC_LOGI("Task cancellation requested");
+        }
+    }
+
+    // Runs fn on the cancelling thread, or right away if already cancelled.
+    void onCancel(CallbackFunction fn) {
+        CancelCallback* node = new CancelCallback{std::move(fn), nullptr};
+        node->next = cancelCallbacks.load(std::memory_order_relaxed);
+        while (!cancelCallbacks.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                                      std::memory_order_relaxed)) {
+        }
+        if (isCancelled()) {
+            runCancelCallbacks();
+        }
+    }
+
+    bool isRunning() const { 
+        return getState() == TaskState::Running && !isCancelled(); 
+    }
+
+    uint32_t getExecutionTime() const {
+        uint32_t started = startTime.load(std::memory_order_relaxed);
+        uint32_t ended = endTime.load(std::memory_order_relaxed);
+        if (started == 0) return 0;
+        if (ended == 0) return millis() - started;
+        return ended - started;
+    }
+
+    void markAdmitted() {
+        admitted.store(true, std::memory_order_relaxed);
+    }
+
+    void releaseSlot();
+
+private:
+    static bool isFinal(TaskState s) {
+        return s == TaskState::Completed || s == TaskState::Failed || s == TaskState::Cancelled;
+    }
+
+    struct CancelCallback {
+        CallbackFunction fn;
+        CancelCallback* next;
+    };
+
+    void runCancelCallbacks() {
+        CancelCallback* node = cancelCallbacks.exchange(nullptr, std::memory_order_acquire);
+        CancelCallback* ordered = nullptr;
+        while (node != nullptr) {
+            CancelCallback* next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+        while (ordered != nullptr) {
+            CancelCallback* next = ordered->next;
+            try {
+                ordered->fn();
+            } catch (...) {
+                ASYNC_LOGE("Exception in cancellation callback");
+            }
+            delete ordered;
+            ordered = next;
+        }
+    }
+
+    // Cancellation, the body starting and the handle being published can
+    // happen in any order; whichever of the three comes last sees the
+    // other two and schedules the kill, exactly once.
+    void killIfStuck() {
+        if (cooperative || !cancelled.load(std::memory_order_seq_cst) ||
+            body.load(std::memory_order_seq_cst) != BodyRunning ||
+            taskHandle.load(std::memory_order_seq_cst) == nullptr ||
+            killScheduled.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        scheduleHardKill();
+    }
+
+    void scheduleHardKill() {
+        extern AsyncConfig globalConfig;
+        std::weak_ptr<TaskHandle> weak = shared_from_this();
+        TaskFunction kill = [weak]() {
+            if (std::shared_ptr<TaskHandle> self = weak.lock()) {
+                self->forceKill();
+            }
+        };
+        if (globalConfig.cancelGraceMs == 0 ||
+            TimerService::instance().schedule(globalConfig.cancelGraceMs, kill) == 0) {
+            forceKill();
+        }
+    }
+
+    static std::atomic<uint32_t>& timeouts() {
+        static std::atomic<uint32_t> count{0};
+        return count;
+    }
+
+    void armWatchdog() {
+        std::weak_ptr<TaskHandle> weak = shared_from_this();
+        TaskFunction fire = [weak]() {
+            if (std::shared_ptr<TaskHandle> self = weak.lock()) {
+                self->onWatchdog();
+            }
+        };
+        TimerId id = TimerService::instance().schedule(timeoutMs, fire);
+        if (id == 0) {
+            ASYNC_LOGW("No timer available for task timeout");
+        }
+        watchdogId.store(id, std::memory_order_release);
+    }
+
+    void onWatchdog() {
+        watchdogId.store(0, std::memory_order_relaxed);
+        if (body.load(std::memory_order_acquire) != BodyRunning) {
+            return;
+        }
+        expired.store(true, std::memory_order_relaxed);
+        timeouts().fetch_add(1, std::memory_order_relaxed);
+        ASYNC_LOGW("Task timed out after %u ms", (unsigned)timeoutMs);
+        cancel();
+        setState(failOnTimeout ? TaskState::Failed : TaskState::Cancelled);
+
+        CallbackFunction* fn = timeoutCallback.exchange(nullptr);
+        if (fn == nullptr) {
+            return;
+        }
+        if (timeoutInLoop) {
+            CallbackQueue::instance().enqueue(std::move(*fn));
+        } else {
+            (*fn)();
+        }
+        delete fn;
+    }
+
+    // The victim is suspended first and only reclaimed once it is off the
+    // other core too, so its job can be freed here without a TLS delete
+    // callback. A task cannot kill itself this way; it has its token.
+    void forceKill() {
+        TaskHandle_t victim = getHandle();
+        uint8_t expected = BodyRunning;
+        if (victim == nullptr || victim == xTaskGetCurrentTaskHandle() ||
+            !body.compare_exchange_strong(expected, BodyKilled, std::memory_order_acq_rel)) {
+            return;
+        }
+        taskHandle.store(nullptr, std::memory_order_release);
+        ASYNC_LOGW("Task ignored cancellation, deleting it");
+        vTaskSuspend(victim);
+        while (eTaskGetState(victim) == eRunning) {
+            vTaskDelay(1);
+        }
+        // A timed-out task already has its final state, set while the body
+        // ran; the body will never reach finishRun(), so free its slot here.
+        setState(TaskState::Cancelled);
+        releaseSlot();
+        if (reclaimFn != nullptr) {
+            reclaimFn(reclaimArg, victim);
+        } else {
+            vTaskDelete(victim);
+        }
+    }
+
+    std::atomic<TaskHandle_t> taskHandle;
+    std::atomic<uint8_t> state;
+    std::atomic<bool> cancelled;
+    std::atomic<uint32_t> startTime;
+    std::atomic<uint32_t> endTime;
+    std::atomic<TimerId> timerId;
+    bool cooperative = false;
+    std::atomic<bool> killScheduled{false};
+    void (*reclaimFn)(void*, TaskHandle_t) = nullptr;
+    void* reclaimArg = nullptr;
+    std::weak_ptr<void> future;
+    void (*failFuture)(void*) = nullptr;
+    std::atomic<bool> admitted{false};
+    std::atomic<CancelCallback*> cancelCallbacks{nullptr};
+    static constexpr uint8_t BodyIdle = 0;
+    static constexpr uint8_t BodyRunning = 1;
+    static constexpr uint8_t BodyKilled = 2;
+    std::atomic<uint8_t> body{BodyIdle};
+    uint32_t timeoutMs = 0;
+    bool failOnTimeout = false;
+    bool timeoutInLoop = true;
+    std::atomic<bool> expired{false};
+    std::atomic<TimerId> watchdogId{0};
+    std::atomic<CallbackFunction*> timeoutCallback{nullptr};
+    const char* name = nullptr;
+    std::unique_ptr<SharedState<PeriodicStats>> periodic;
+#ifdef ASYNC_TRACE
+    std::atomic<uint32_t> traceStartUs{0};
+
+public:
+    uint32_t traceId() const { return (uint32_t)(uintptr_t)this; }
+#endif
+};
+
+struct AdmissionStats {
+    uint16_t running;
+    uint16_t pending;
+    uint16_t peakPending;
+    uint32_t admitted;
+    uint32_t queued;
+    uint32_t rejected;
+    uint32_t dropped;
+};
+
+// Caps in-flight tasks at AsyncConfig::maxConcurrentTasks (0 = unlimited).
+// A task holds its slot from launch until its handle reaches a terminal
+// state and its body has returned, so a timed-out task still stuck on a
+// worker keeps counting; tasks over the limit wait in a bounded pending queue.
+class AdmissionControl {
+public:
+    using Launcher = TimerService::Launcher;
+
+    static AdmissionControl& instance() {
+        static AdmissionControl instance;
+        return instance;
+    }
+
+    bool tryAcquire() {
+        extern AsyncConfig globalConfig;
+        uint16_t limit = globalConfig.maxConcurrentTasks;
+        uint16_t current = running.load(std::memory_order_relaxed);
+        do {
+            if (limit > 0 && current >= limit) {
+                return false;
+            }
+        } while (!running.compare_exchange_weak(current, current + 1, std::memory_order_acquire));
+        admitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void release() {
+        running.fetch_sub(1, std::memory_order_release);
+        drain();
+    }
+
+    bool defer(TaskFunction& func, TaskConfig& config, const std::shared_ptr<TaskHandle>& handle,
+               UBaseType_t priority, Launcher launcher) {
+        extern AsyncConfig globalConfig;
+        while (true) {
+            // Destroyed after the lock is given back: a Future's runner fails
+            // its state on the way out, which runs continuations.
+            TaskFunction evictedFunc;
+            std::shared_ptr<TaskHandle> evicted;
+            xSemaphoreTake(lock, portMAX_DELAY);
+            Entry* entry = freeEntry();
+            if (entry == nullptr && globalConfig.pendingOverflow == PendingPolicy::DropOldest) {
+                entry = pick(false);
+                if (entry != nullptr) {
+                    evicted = std::move(entry->handle);
+                    evictedFunc = std::move(entry->func);
+                    entry->used = false;
+                    pendingCount.fetch_sub(1, std::memory_order_relaxed);
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (entry != nullptr) {
+                entry->func = std::move(func);
+                entry->config = config;
+                entry->handle = handle;
+                entry->launcher = launcher;
+                entry->priority = priority;
+                entry->sequence = nextSequence++;
+                entry->used = true;
+                uint16_t count = pendingCount.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (count > peakPending) {
+                    peakPending = count;
+                }
+            }
+            xSemaphoreGive(lock);
+
+            if (evicted) {
+                ASYNC_LOGW("Pending queue full, oldest task dropped");
+                evicted->setState(TaskState::Cancelled);
+            }
+            if (entry != nullptr) {
+                queued.fetch_add(1, std::memory_order_relaxed);
+                drain();
+                return true;
+            }
+            // Blocking the timer task would stall every other timer.
+            if (globalConfig.pendingOverflow != PendingPolicy::Block ||
+                TimerService::instance().onTimerTask()) {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                ASYNC_LOGW("Pending queue full, task rejected");
+                handle->setState(TaskState::Failed);
+                return false;
+            }
+            vTaskDelay(1);
+        }
+    }
+
+    AdmissionStats stats() {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        uint16_t peak = peakPending;
+        xSemaphoreGive(lock);
+        return AdmissionStats{
+            running.load(std::memory_order_relaxed),
+            pendingCount.load(std::memory_order_relaxed),
+            peak,
+            admitted.load(std::memory_order_relaxed),
+            queued.load(std::memory_order_relaxed),
+            rejected.load(std::memory_order_relaxed),
+            dropped.load(std::memory_order_relaxed)};
+    }
+
+private:
+    struct Entry {
+        TaskFunction func;
+        TaskConfig config;
+        std::shared_ptr<TaskHandle> handle;
+        Launcher launcher = nullptr;
+        UBaseType_t priority = 0;
+        uint32_t sequence = 0;
+        bool used = false;
+    };
+
+    Entry* entries;
+    uint16_t capacity;
+    uint32_t nextSequence = 0;
+    uint16_t peakPending = 0;
+    SemaphoreHandle_t lock;
+    std::atomic<uint16_t> running{0};
+    std::atomic<uint16_t> pendingCount{0};
+    std::atomic<uint32_t> admitted{0};
+    std::atomic<uint32_t> queued{0};
+    std::atomic<uint32_t> rejected{0};
+    std::atomic<uint32_t> dropped{0};
+
+    AdmissionControl() : capacity(configuredCapacity()), lock(xSemaphoreCreateMutex()) {
+        entries = new Entry[capacity];
+    }
+
+    static uint16_t configuredCapacity() {
+        extern AsyncConfig globalConfig;
+        return globalConfig.pendingQueueSize > 0 ? globalConfig.pendingQueueSize : 1;
+    }
+
+    Entry* freeEntry() {
+        for (uint16_t i = 0; i < capacity; i++) {
+            if (!entries[i].used) {
+                return &entries[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Oldest entry, or the oldest of the highest priority when byPriority.
+    Entry* pick(bool byPriority) {
+        Entry* best = nullptr;
+        for (uint16_t i = 0; i < capacity; i++) {
+            Entry& e = entries[i];
+            if (!e.used) {
+                continue;
+            }
+            if (best == nullptr ||
+                (byPriority && e.priority > best->priority) ||
+                ((!byPriority || e.priority == best->priority) &&
+                 (int32_t)(e.sequence - best->sequence) < 0)) {
+                best = &e;
+            }
+        }
+        return best;
+    }
+
+    void drain() {
+        extern AsyncConfig globalConfig;
+        while (pendingCount.load() > 0 && tryAcquire()) {
+            TaskFunction func;
+            TaskConfig config;
+            std::shared_ptr<TaskHandle> handle;
+            Launcher launcher = nullptr;
+
+            xSemaphoreTake(lock, portMAX_DELAY);
+            Entry* entry = pick(globalConfig.prioritizePending);
+            if (entry != nullptr) {
+                func = std::move(entry->func);
+                config = entry->config;
+                handle = std::move(entry->handle);
+                launcher = entry->launcher;
+                entry->used = false;
+                pendingCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+            xSemaphoreGive(lock);
+
+            if (!handle) {
+                admitted.fetch_sub(1, std::memory_order_relaxed);
+                running.fetch_sub(1, std::memory_order_release);
+                continue;
+            }
+            handle->markAdmitted();
+            if (handle->isCancelled()) {
+                handle->setState(TaskState::Cancelled);
+                continue;
+            }
+            if (!launcher(func, config, handle)) {
+                ASYNC_LOGW("Deferred task failed to launch");
+                handle->setState(TaskState::Failed);
+            }
+        }
+    }
+};
+
+inline void TaskHandle::releaseSlot() {
+    if (admitted.exchange(false, std::memory_order_acq_rel)) {
+        AdmissionControl::instance().release();
+    }
+}
+
+// Handed to task bodies that take one. Only valid while the body runs.
+class CancellationToken {
+public:
+    CancellationToken() : handle(nullptr) {}
+
+    explicit CancellationToken(TaskHandle* h) : handle(h) {}
+
+    bool isCancellationRequested() const {
+        return handle != nullptr && handle->isCancelled();
+    }
+
+    void onCancel(CallbackFunction fn) const {
+        if (handle != nullptr) {
+            handle->onCancel(std::move(fn));
+        }
+    }
+
+private:
+    TaskHandle* handle;
+};
+
+template<typename Func, typename = void>
+struct TaskBody {
+    using Result = decltype(std::declval<Func&>()());
+
+    static Result invoke(Func& func, TaskHandle*) {
+        return func();
+    }
+};
+
+template<typename Func>
+struct TaskBody<Func, decltype((void)std::declval<Func&>()(std::declval<CancellationToken>()))> {
+    using Result = decltype(std::declval<Func&>()(std::declval<CancellationToken>()));
+
+    static Result invoke(Func& func, TaskHandle* h) {
+        return func(CancellationToken(h));
+    }
+};
+
+class WorkerPool {
+public:
+    static WorkerPool& instance() {
+        static WorkerPool instance;
+        return instance;
+    }
+
+    // Fails when the lane has no worker, so the caller falls back to a
+    // dedicated task instead of queueing a job nothing will run.
+    bool submit(TaskFunction& job, BaseType_t core, UBaseType_t priority) {
+        Lane& lane = laneFor(core);
+        if (lane.workers == 0) {
+            return false;
+        }
+
+        Job entry{std::move(job), priority};
+        if (!lane.jobs->tryPush(std::move(entry))) {
+            job = std::move(entry.func);
+            ASYNC_LOGW("Worker queue full, job rejected");
+            return false;
+        }
+        xSemaphoreGive(lane.available);
+        return true;
+    }
+
+    size_t workerCount() const {
+        size_t total = 0;
+        for (const Lane& lane : lanes) {
+            total += lane.workers;
+        }
+        return total;
+    }
+
+    uint32_t stackSize() const {
+        return workerStackSize;
+    }
+
+    size_t pendingJobs() const {
+        size_t total = 0;
+        for (const Lane& lane : lanes) {
+            if (lane.jobs) {
+                total += lane.jobs->size();
+            }
+        }
+        return total;
+    }
+
+private:
+    struct Job {
+        TaskFunction func;
+        UBaseType_t priority;
+    };
+
+    struct Lane {
+        BoundedRing<Job>* jobs = nullptr;
+        SemaphoreHandle_t available = nullptr;
+        uint8_t workers = 0;
+    };
+
+    struct WorkerArgs {
+        WorkerPool* pool;
+        Lane* lane;
+    };
+
+    Lane lanes[portNUM_PROCESSORS];
+    WorkerArgs args[portNUM_PROCESSORS];
+    uint16_t queueSize = 0;
+    uint32_t workerStackSize = 0;
+    UBaseType_t basePriority = 0;
+
+    WorkerPool() {
+        extern AsyncConfig globalConfig;
+        queueSize = globalConfig.workerQueueSize > 0 ? globalConfig.workerQueueSize : 1;
+        workerStackSize = globalConfig.defaultStackSize;
+        basePriority = globalConfig.defaultPriority;
+
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            Lane& lane = lanes[core];
+            lane.jobs = new BoundedRing<Job>(queueSize);
+            lane.available = xSemaphoreCreateCounting(lane.jobs->capacity(), 0);
+            args[core] = WorkerArgs{this, &lane};
+        }
+
+        for (uint8_t i = 0; i < globalConfig.workersPerCore; i++) {
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                // Sized for any int/uint8_t pair; FreeRTOS truncates the name.
+                char name[32];
+                snprintf(name, sizeof(name), "AsyncWorker%d_%u", core, (unsigned)i);
+                BaseType_t result = xTaskCreatePinnedToCore(workerLoop, name, workerStackSize,
+                                                            &args[core], basePriority,
+                                                            nullptr, core);
+                if (result != pdPASS) {
+                    ASYNC_LOGE("Failed to create worker '%s'", name);
+                    continue;
+                }
+                lanes[core].workers++;
+            }
+        }
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            if (lanes[core].workers == 0) {
+                ASYNC_LOGW("No workers on core %d, its tasks run dedicated", (int)core);
+            }
+        }
+        ASYNC_LOGI("Worker pool started: %u workers (stack: %u, priority: %u)",
+                  (unsigned)workerCount(), (unsigned)workerStackSize, (unsigned)basePriority);
+    }
+
+    Lane& laneFor(BaseType_t core) {
+        if (core >= 0 && core < portNUM_PROCESSORS) {
+            return lanes[core];
+        }
+        Lane* best = &lanes[0];
+        for (Lane& lane : lanes) {
+            if (lane.workers > 0 &&
+                (best->workers == 0 || lane.jobs->size() < best->jobs->size())) {
+                best = &lane;
+            }
+        }
+        return *best;
+    }
+
+    static void workerLoop(void* param) {
+        auto* args = static_cast<WorkerArgs*>(param);
+        Lane& lane = *args->lane;
+        UBaseType_t basePriority = args->pool->basePriority;
+
+        while (true) {
+            if (xSemaphoreTake(lane.available, portMAX_DELAY) != pdTRUE) {
+                continue;
+            }
+            Job job;
+            if (!lane.jobs->tryPop(job)) {
+                continue;
+            }
+
+            if (job.priority != basePriority) {
+                vTaskPrioritySet(NULL, job.priority);
+            }
+            try {
+                job.func();
+            } catch (...) {
+                ASYNC_LOGE("Exception in pooled task");
+            }
+            if (job.priority != basePriority) {
+                vTaskPrioritySet(NULL, basePriority);
+            }
+        }
+    }
+};
+
+// Per-chunk partial results for ParallelReduce. Every slot is copied from a
+// seed, so T needs no default constructor.
+template<typename T>
+class ReducePartials {
+public:
+    ReducePartials(size_t count, const T& seed)
+        : slots(static_cast<T*>(::operator new(count * sizeof(T)))), built(0) {
+        try {
+            for (; built < count; built++) {
+                new (slots + built) T(seed);
+            }
+        } catch (...) {
+            destroy();
+            throw;
+        }
+    }
+
+    ~ReducePartials() {
+        destroy();
+    }
+
+    ReducePartials(const ReducePartials&) = delete;
+    ReducePartials& operator=(const ReducePartials&) = delete;
+
+    T& operator[](size_t i) {
+        return slots[i];
+    }
+
+private:
+    void destroy() {
+        while (built > 0) {
+            slots[--built].~T();
+        }
+        ::operator delete(slots);
+    }
+
+    T* slots;
+    size_t built;
+};
+
+// Runs chunk(i) for i in [0, chunks) on the calling task plus one pooled
+// helper per other core. The chunk function stays on the caller's stack:
+// helpers only call it for chunks they claim, and every chunk finishes
+// before run() returns. Late helpers find nothing left and exit.
+class ParallelJob {
+public:
+    template<typename Chunk>
+    static bool run(size_t chunks, Chunk& chunk) {
+        if (chunks == 0) {
+            return true;
+        }
+        auto state = std::make_shared<ParallelJob>(chunks, &chunk, &invokeChunk<Chunk>);
+        if (chunks > 1) {
+            BaseType_t self = xPortGetCoreID();
+            UBaseType_t priority = uxTaskPriorityGet(NULL);
+            for (int core = 0; core < portNUM_PROCESSORS && (size_t)core < chunks; core++) {
+                if (core == self) {
+                    continue;
+                }
+                TaskFunction helper = [state]() { state->work(); };
+                WorkerPool::instance().submit(helper, core, priority);
+            }
+        }
+        state->work();
+        if (state->remaining.load(std::memory_order_acquire) != 0) {
+            xSemaphoreTake(state->done, portMAX_DELAY);
+        }
+        return !state->failed.load(std::memory_order_relaxed);
+    }
+
+    ParallelJob(size_t count, void* ctx, void (*fn)(void*, size_t))
+        : chunks(count), context(ctx), invoke(fn), remaining(count) {
+        done = xSemaphoreCreateBinaryStatic(&doneBuffer);
+    }
+
+    ~ParallelJob() {
+        vSemaphoreDelete(done);
+    }
+
+    ParallelJob(const ParallelJob&) = delete;
+    ParallelJob& operator=(const ParallelJob&) = delete;
+
+private:
+    size_t chunks;
+    void* context;
+    void (*invoke)(void*, size_t);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed{false};
+    StaticSemaphore_t doneBuffer;
+    SemaphoreHandle_t done;
+
+    template<typename Chunk>
+    static void invokeChunk(void* ctx, size_t index) {
+        (*static_cast<Chunk*>(ctx))(index);
+    }
+
+    void work() {
+        size_t index;
+        while ((index = next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+            try {
+                invoke(context, index);
+            } catch (...) {
+                ASYNC_LOGE("Exception in parallel chunk");
+                failed.store(true, std::memory_order_relaxed);
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                xSemaphoreGive(done);
+            }
+        }
+    }
+};
+
+struct StackClassStats {
+    uint32_t stackSize;
+    uint8_t capacity;
+    uint8_t inUse;
+    uint8_t peakInUse;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+struct StackPoolStats {
+    StackClassStats classes[ASYNC_STACK_CLASSES];
+    uint32_t oversize;
+    uint32_t dynamicFallbacks;
+};
+
+#ifndef ASYNC_STACK_PROFILE_ENTRIES
+    #define ASYNC_STACK_PROFILE_ENTRIES 16
+#endif
+
+struct StackHint {
+    const char* name;
+    uint32_t stackSize;
+};
+
+struct StackProfileEntry {
+    char name[16];
+    uint32_t maxUsed;
+    uint32_t allocated;
+    uint32_t samples;
+    uint32_t hint;
+};
+
+// Per-name stack high-water marks of tasks that own their stack (dedicated
+// and static-stack tasks; pooled jobs share worker stacks and are skipped).
+class StackProfiler {
+public:
+    static StackProfiler& instance() {
+        static StackProfiler instance;
+        return instance;
+    }
+
+    static void sampleCurrent(const char* name, uint32_t stackSize) {
+        extern AsyncConfig globalConfig;
+        if (!globalConfig.profileStacks || name == nullptr) {
+            return;
+        }
+        uint32_t freeBytes = uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t);
+        instance().record(name, stackSize, stackSize > freeBytes ? stackSize - freeBytes : 0);
+    }
+
+    void record(const char* name, uint32_t allocated, uint32_t used) {
+        portENTER_CRITICAL(&lock);
+        if (StackProfileEntry* entry = find(name, true)) {
+            if (used > entry->maxUsed) {
+                entry->maxUsed = used;
+            }
+            entry->allocated = allocated;
+            entry->samples++;
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+
+    void load(const StackHint* hints, size_t count) {
+        portENTER_CRITICAL(&lock);
+        for (size_t i = 0; i < count; i++) {
+            if (StackProfileEntry* entry = find(hints[i].name, true)) {
+                entry->hint = hints[i].stackSize;
+            }
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+
+    // 0 when nothing is known about the name.
+    uint32_t learnedStackSize(const char* name, uint32_t margin) {
+        uint32_t size = 0;
+        portENTER_CRITICAL(&lock);
+        if (StackProfileEntry* entry = find(name, false)) {
+            size = entry->hint;
+            if (entry->samples > 0 && entry->maxUsed + margin > size) {
+                size = entry->maxUsed + margin;
+            }
+        }
+        portEXIT_CRITICAL(&lock);
+        if (size == 0) {
+            return 0;
+        }
+        size = (size + 255) & ~255u;
+        return size < MinStackSize ? MinStackSize : size;
+    }
+
+    size_t snapshot(StackProfileEntry* out, size_t max) {
+        portENTER_CRITICAL(&lock);
+        size_t n = used < max ? used : max;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = entries[i];
+        }
+        portEXIT_CRITICAL(&lock);
+        return n;
+    }
+
+    uint32_t droppedNames() const {
+        return dropped;
+    }
+
+    // Prints the table as a StackHint array ready to paste into a sketch.
+    void dump(Print& out, uint32_t margin) {
+        StackProfileEntry copy[ASYNC_STACK_PROFILE_ENTRIES];
+        size_t n = snapshot(copy, ASYNC_STACK_PROFILE_ENTRIES);
+        out.printf("// EasyAsync learned stack sizes (margin %u bytes)\n", (unsigned)margin);
+        out.print("const StackHint stackHints[] = {\n");
+        for (size_t i = 0; i < n; i++) {
+            out.printf("    {\"%s\", %u},  // max used %u of %u bytes, %u samples\n",
+                       copy[i].name, (unsigned)learnedStackSize(copy[i].name, margin),
+                       (unsigned)copy[i].maxUsed, (unsigned)copy[i].allocated,
+                       (unsigned)copy[i].samples);
+        }
+        out.print("};\n");
+    }
+
+private:
+    static constexpr uint32_t MinStackSize = 1024;
+
+    StackProfileEntry entries[ASYNC_STACK_PROFILE_ENTRIES];
+    size_t used = 0;
+    uint32_t dropped = 0;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    StackProfiler() {}
+
+    StackProfileEntry* find(const char* name, bool create) {
+        for (size_t i = 0; i < used; i++) {
+            if (strncmp(entries[i].name, name, sizeof(entries[i].name) - 1) == 0) {
+                return &entries[i];
+            }
+        }
+        if (!create) {
+            return nullptr;
+        }
+        if (used == ASYNC_STACK_PROFILE_ENTRIES) {
+            dropped++;
+            return nullptr;
+        }
+        StackProfileEntry& entry = entries[used++];
+        entry = StackProfileEntry();
+        strncpy(entry.name, name, sizeof(entry.name) - 1);
+        return &entry;
+    }
+};
+
+class StaticStackPool {
+public:
+    struct Slot {
+        StackType_t* stack = nullptr;
+        StaticTask_t tcb;
+        uint32_t stackSize = 0;
+        uint8_t stackClass = 0;
+        std::atomic<uint8_t> state{SlotFree};
+        std::atomic<TaskHandle_t> task{nullptr};
+        const char* name = nullptr;
+        TaskFunction func;
+    };
+
+    static StaticStackPool& instance() {
+        static StaticStackPool instance;
+        return instance;
+    }
+
+    void configure(const AsyncConfig& config) {
+        if (!config.useStaticStacks || slots != nullptr) {
+            return;
+        }
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            if (esp_register_freertos_idle_hook_for_cpu(&StaticStackPool::onIdle, core) != ESP_OK) {
+                esp_deregister_freertos_idle_hook(&StaticStackPool::onIdle);
+                ASYNC_LOGE("Static stacks need an idle hook on every core");
+                return;
+            }
+        }
+        size_t total = 0;
+        for (const StackClass& sc : config.stackClasses) {
+            total += sc.count;
+        }
+        slots = new Slot[total];
+        slotCount = total;
+
+        size_t index = 0;
+        for (uint8_t c = 0; c < ASYNC_STACK_CLASSES; c++) {
+            const StackClass& sc = config.stackClasses[c];
+            classes[c] = ClassState{sc.stackSize, index, sc.count};
+            for (uint8_t i = 0; i < sc.count; i++, index++) {
+                slots[index].stack = new StackType_t[sc.stackSize / sizeof(StackType_t)];
+                slots[index].stackSize = sc.stackSize;
+                slots[index].stackClass = c;
+            }
+            ASYNC_LOGI("Static stack class %u: %u x %u bytes", (unsigned)c, (unsigned)sc.count,
+                       (unsigned)sc.stackSize);
+        }
+    }
+
+    bool enabled() const {
+        return slots != nullptr;
+    }
+
+    Slot* acquire(uint32_t stackSize) {
+        int best = -1;
+        for (uint8_t c = 0; c < ASYNC_STACK_CLASSES; c++) {
+            if (classes[c].stackSize >= stackSize && classes[c].count > 0 &&
+                (best < 0 || classes[c].stackSize < classes[best].stackSize)) {
+                best = c;
+            }
+        }
+        if (best < 0) {
+            oversize.fetch_add(1, std::memory_order_relaxed);
+            dynamicFallbacks.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        bool missed = false;
+        for (uint8_t c = best; c < ASYNC_STACK_CLASSES; c++) {
+            if (classes[c].stackSize < stackSize) {
+                continue;
+            }
+            if (Slot* slot = tryAcquire(classes[c])) {
+                classes[c].hits.fetch_add(1, std::memory_order_relaxed);
+                return slot;
+            }
+            if (!missed) {
+                classes[c].misses.fetch_add(1, std::memory_order_relaxed);
+                missed = true;
+            }
+        }
+        dynamicFallbacks.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // For slots whose TCB was never handed to the kernel, or is done with.
+    void release(Slot* slot) {
+        ClassState& cls = classes[slot->stackClass];
+        slot->state.store(SlotFree, std::memory_order_release);
+        cls.inUse.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    StackPoolStats stats() const {
+        StackPoolStats result = {};
+        for (uint8_t c = 0; c < ASYNC_STACK_CLASSES; c++) {
+            const ClassState& cls = classes[c];
+            result.classes[c] = StackClassStats{
+                cls.stackSize, cls.count,
+                cls.inUse.load(std::memory_order_relaxed),
+                cls.peakInUse.load(std::memory_order_relaxed),
+                cls.hits.load(std::memory_order_relaxed),
+                cls.misses.load(std::memory_order_relaxed)};
+        }
+        result.oversize = oversize.load(std::memory_order_relaxed);
+        result.dynamicFallbacks = dynamicFallbacks.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    // A task deleting itself leaves its TCB to the idle task with no word
+    // on when it is done, so a finished task suspends itself instead and an
+    // idle hook deletes it, after which the slot is free at once.
+    static void taskEntry(void* param) {
+        auto* slot = static_cast<Slot*>(param);
+        slot->task.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+        try {
+            slot->func();
+        } catch (...) {
+            ASYNC_LOGE("Exception in task");
+        }
+        StackProfiler::sampleCurrent(slot->name, slot->stackSize);
+        retire(slot);
+        while (true) {
+            vTaskSuspend(NULL);
+        }
+    }
+
+    // TaskHandle reclaim hook for a hard-killed task, which is already
+    // suspended for good.
+    static void reclaim(void* param, TaskHandle_t victim) {
+        auto* slot = static_cast<Slot*>(param);
+        slot->task.store(victim, std::memory_order_relaxed);
+        retire(slot);
+    }
+
+private:
+    static constexpr uint8_t SlotFree = 0;
+    static constexpr uint8_t SlotInUse = 1;
+    static constexpr uint8_t SlotRetired = 2;
+    static constexpr uint8_t SlotReaping = 3;
+
+    struct ClassState {
+        uint32_t stackSize = 0;
+        size_t first = 0;
+        uint8_t count = 0;
+        std::atomic<uint8_t> inUse{0};
+        std::atomic<uint8_t> peakInUse{0};
+        std::atomic<uint32_t> hits{0};
+        std::atomic<uint32_t> misses{0};
+
+        ClassState() {}
+
+        ClassState(uint32_t size, size_t firstSlot, uint8_t slotCount)
+            : stackSize(size), first(firstSlot), count(slotCount) {}
+
+        ClassState& operator=(const ClassState& other) {
+            stackSize = other.stackSize;
+            first = other.first;
+            count = other.count;
+            return *this;
+        }
+    };
+
+    Slot* slots = nullptr;
+    size_t slotCount = 0;
+    ClassState classes[ASYNC_STACK_CLASSES];
+    std::atomic<uint32_t> oversize{0};
+    std::atomic<uint32_t> dynamicFallbacks{0};
+    std::atomic<uint32_t> retiredCount{0};
+
+    StaticStackPool() {}
+
+    Slot* tryAcquire(ClassState& cls) {
+        for (size_t i = cls.first; i < cls.first + cls.count; i++) {
+            Slot& slot = slots[i];
+            uint8_t expected = SlotFree;
+            if (slot.state.compare_exchange_strong(expected, SlotInUse, std::memory_order_acquire)) {
+                uint8_t used = cls.inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+                uint8_t peak = cls.peakInUse.load(std::memory_order_relaxed);
+                while (used > peak &&
+                       !cls.peakInUse.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+                }
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    static void retire(Slot* slot) {
+        slot->func = nullptr;
+        slot->state.store(SlotRetired, std::memory_order_release);
+        instance().retiredCount.fetch_add(1, std::memory_order_release);
+    }
+
+    // Reaps retired slots whose task has stopped. Each task is deleted by the
+    // idle hook of a core that frees it on the spot: the core it is pinned
+    // to, or core 0 for an unpinned one. Deleting a task pinned to the other
+    // core would defer the cleanup to that core's idle task.
+    static bool onIdle() {
+        StaticStackPool& pool = StaticStackPool::instance();
+        if (pool.retiredCount.load(std::memory_order_acquire) == 0) {
+            return true;
+        }
+        BaseType_t core = xPortGetCoreID();
+        for (size_t i = 0; i < pool.slotCount; i++) {
+            Slot& slot = pool.slots[i];
+            if (slot.state.load(std::memory_order_acquire) != SlotRetired) {
+                continue;
+            }
+            TaskHandle_t task = slot.task.load(std::memory_order_relaxed);
+            BaseType_t affinity = xTaskGetAffinity(task);
+            if ((affinity == tskNO_AFFINITY ? 0 : affinity) != core ||
+                eTaskGetState(task) != eSuspended) {
+                continue;
+            }
+            uint8_t expected = SlotRetired;
+            if (!slot.state.compare_exchange_strong(expected, SlotReaping,
+                                                    std::memory_order_acquire)) {
+                continue;
+            }
+            vTaskDelete(task);
+            pool.retiredCount.fetch_sub(1, std::memory_order_relaxed);
+            pool.release(&slot);
+        }
+        return true;
+    }
+};
+
+class Task {
+public:
+    Task() : handle(std::make_shared<TaskHandle>()), config() {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    
+    Task(Task&& other) noexcept : handle(std::move(other.handle)), 
+                                   config(other.config),
+                                   taskFunc(std::move(other.taskFunc)) {}
+    
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            handle = std::move(other.handle);
+            config = other.config;
+            taskFunc = std::move(other.taskFunc);
+        }
+        return *this;
+    }
+
+    template<typename Func, typename Callback>
+    Task(Func func, Callback callback, const TaskConfig& cfg) 
+        : handle(std::make_shared<TaskHandle>()), config(cfg) {
+        taskFunc = CallbackRunner<Func, Callback>(std::move(func), std::move(callback), handle,
+                                                  cfg.executeInLoop, cfg.callbackPriority);
+    }
+
+    template<typename Func>
+    static Task periodic(uint32_t periodMs, Func func, const TaskConfig& cfg) {
+        Task task;
+        task.config = cfg;
+        task.config.dedicated = true;
+        TickType_t period = pdMS_TO_TICKS(periodMs) > 0 ? pdMS_TO_TICKS(periodMs) : 1;
+        task.handle->enablePeriodic(period * portTICK_PERIOD_MS * 1000);
+        task.taskFunc = PeriodicRunner<Func>(std::move(func), task.handle, period);
+        task.run();
+        return task;
+    }
+
+    template<typename Func, typename State>
+    static Task forFuture(Func func, const std::shared_ptr<State>& state, const TaskConfig& cfg) {
+        Task task;
+        task.config = cfg;
+        task.taskFunc = FutureRunner<Func, State>(std::move(func), state, task.handle);
+        task.handle->bindFuture(state, &Task::failState<State>);
+        return task;
+    }
+
+    const std::shared_ptr<TaskHandle>& getHandle() const {
+        return handle;
+    }
+
+    bool run() {
+        return launch(taskFunc, config, handle);
+    }
+
+    bool runAfter(uint32_t delayMs) {
+        if (!taskFunc) {
+            ASYNC_LOGE("Task function is null");
+            return false;
+        }
+
+        TimerId id = TimerService::instance().schedule(delayMs, taskFunc, &Task::launch,
+                                                       config, handle);
+        if (id != 0) {
+            handle->setTimer(id);
+            return true;
+        }
+
+        ASYNC_LOGW("No timer available, delaying on a dedicated task");
+        taskFunc = DelayedStart(delayMs, new TaskFunction(std::move(taskFunc)));
+        config.dedicated = true;
+        return run();
+    }
+
+    static bool launch(TaskFunction& taskFunc, TaskConfig& config,
+                       const std::shared_ptr<TaskHandle>& handle) {
+        if (!taskFunc) {
+            ASYNC_LOGE("Task function is null");
+            return false;
+        }
+
+        handle->setName(config.name);
+        ASYNC_TRACE_EVENT(TraceEvent::Submit, config.name, handle->traceId(), 0);
+
+        AdmissionControl& admission = AdmissionControl::instance();
+        if (admission.tryAcquire()) {
+            handle->markAdmitted();
+            return start(taskFunc, config, handle);
+        }
+        extern AsyncConfig globalConfig;
+        UBaseType_t priority = config.priority > 0 ? config.priority : globalConfig.defaultPriority;
+        return admission.defer(taskFunc, config, handle, priority, &Task::start);
+    }
+
+    static bool start(TaskFunction& taskFunc, TaskConfig& config,
+                      const std::shared_ptr<TaskHandle>& handle) {
+        extern AsyncConfig globalConfig;
+        handle->setTimeout(config.timeoutMs, config.failOnTimeout, config.executeInLoop);
+        uint32_t stackSize = config.stackSize > 0 ? config.stackSize : globalConfig.defaultStackSize;
+        if (config.stackSize == 0 && config.name != nullptr && globalConfig.useLearnedStacks) {
+            uint32_t learned = StackProfiler::instance().learnedStackSize(
+                config.name, globalConfig.learnedStackMargin);
+            if (learned > 0) {
+                stackSize = learned;
+            }
+        }
+        UBaseType_t priority = config.priority > 0 ? config.priority : globalConfig.defaultPriority;
+        BaseType_t core = config.core != tskNO_AFFINITY ? config.core : globalConfig.defaultCore;
+
+        if (!config.dedicated) {
+            WorkerPool& pool = WorkerPool::instance();
+            if (stackSize <= pool.stackSize() && pool.submit(taskFunc, core, priority)) {
+                ASYNC_LOGD("Task '%s' queued on worker pool", config.name ? config.name : "?");
+                return true;
+            }
+        }
+
+        static uint32_t taskCounter = 0;
+        char taskName[16];
+        const char* name = config.name;
+        if (name == nullptr) {
+            snprintf(taskName, sizeof(taskName), "Task_%lu", (unsigned long)taskCounter++);
+            name = taskName;
+        }
+
+        StaticStackPool& stacks = StaticStackPool::instance();
+        if (stacks.enabled()) {
+            if (StaticStackPool::Slot* slot = stacks.acquire(stackSize)) {
+                slot->func = std::move(taskFunc);
+                slot->name = config.name;
+                handle->setReclaim(&StaticStackPool::reclaim, slot);
+                TaskHandle_t taskHandle = xTaskCreateStaticPinnedToCore(
+                    StaticStackPool::taskEntry, name, slot->stackSize, slot, priority,
+                    slot->stack, &slot->tcb, core);
+                if (taskHandle != nullptr) {
+                    ASYNC_LOGD("Creating static task '%s' (stack: %u, priority: %u)",
+                              name, (unsigned)slot->stackSize, (unsigned)priority);
+                    handle->setHandle(taskHandle);
+                    return true;
+                }
+                handle->setReclaim(nullptr, nullptr);
+                taskFunc = std::move(slot->func);
+                stacks.release(slot);
+            }
+        }
+
+        // A task that returns frees its own job; one deleted after its
+        // cancellation grace period has it freed by the killer instead
+        // (see reclaimDedicated).
+        auto wrapper = [](void* param) {
+            auto* job = static_cast<DedicatedJob*>(param);
+            try {
+                job->func();
+            } catch (...) {
+                ASYNC_LOGE("Exception in task");
+            }
+            StackProfiler::sampleCurrent(job->name, job->stackSize);
+            delete job;
+            vTaskDelete(NULL);
+        };
+
+        auto* job = new DedicatedJob{std::move(taskFunc), config.name, stackSize};
+        handle->setReclaim(&Task::reclaimDedicated, job);
+        TaskHandle_t taskHandle = nullptr;
+
+        BaseType_t result;
+        if (core != tskNO_AFFINITY) {
+            result = xTaskCreatePinnedToCore(wrapper, name, stackSize, 
+                                            job, priority, &taskHandle, core);
+            ASYNC_LOGD("Creating task '%s' on core %d (stack: %u, priority: %u)", 
+                     name, (int)core, (unsigned)stackSize, (unsigned)priority);
+        } else {
+            result = xTaskCreate(wrapper, name, stackSize, 
+                               job, priority, &taskHandle);
+            ASYNC_LOGD("Creating task '%s' on any core (stack: %u, priority: %u)", 
+                     name, (unsigned)stackSize, (unsigned)priority);
+        }
+
+        if (result != pdPASS) {
+            ASYNC_LOGE("Failed to create task");
+            handle->setReclaim(nullptr, nullptr);
+            taskFunc = std::move(job->func);
+            delete job;
+            handle->setState(TaskState::Failed);
+            return false;
+        }
+
+        handle->setHandle(taskHandle);
+        return true;
+    }
+
+    void cancel() {
+        if (handle) {
+            handle->cancel();
+        }
+    }
+
+    TaskState getState() const {
+        return handle ? handle->getState() : TaskState::Failed;
+    }
+
+    bool isRunning() const {
+        return handle ? handle->isRunning() : false;
+    }
+
+    bool isCancelled() const {
+        return handle ? handle->isCancelled() : false;
+    }
+
+    bool timedOut() const {
+        return handle ? handle->timedOut() : false;
+    }
+
+    void onTimeout(CallbackFunction fn) {
+        if (handle) {
+            handle->onTimeout(std::move(fn));
+        }
+    }
+
+    uint32_t getExecutionTime() const {
+        return handle ? handle->getExecutionTime() : 0;
+    }
+
+    PeriodicStats periodicStats() const {
+        SharedState<PeriodicStats>* stats = handle ? handle->periodicStats() : nullptr;
+        return stats ? stats->load() : PeriodicStats();
+    }
+
+private:
+    struct DedicatedJob {
+        TaskFunction func;
+        const char* name;
+        uint32_t stackSize;
+    };
+
+    // Task bodies are plain functors rather than init-capture lambdas so the
+    // header stays C++11 for the Arduino-ESP32 toolchain.
+    template<typename Func, typename Callback>
+    struct CallbackRunner {
+        CallbackRunner(Func&& f, Callback&& cb, const std::shared_ptr<TaskHandle>& h, bool loop,
+                       CallbackPriority p)
+            : func(std::move(f)), callback(std::move(cb)), handle(h), inLoop(loop), priority(p) {}
+
+        void operator()() {
+            executeTask(func, callback, handle, inLoop, priority,
+                        (typename TaskBody<Func>::Result*)nullptr);
+        }
+
+        Func func;
+        Callback callback;
+        std::shared_ptr<TaskHandle> handle;
+        bool inLoop;
+        CallbackPriority priority;
+    };
+
+    template<typename Func>
+    struct PeriodicRunner {
+        PeriodicRunner(Func&& f, const std::shared_ptr<TaskHandle>& h, TickType_t p)
+            : func(std::move(f)), handle(h), period(p) {}
+
+        void operator()() {
+            runPeriodic(func, handle, period);
+        }
+
+        Func func;
+        std::shared_ptr<TaskHandle> handle;
+        TickType_t period;
+    };
+
+    template<typename State>
+    static void failState(void* state) {
+        static_cast<State*>(state)->fail();
+    }
+
+    // A runner dropped without running (evicted, cancelled while queued, or
+    // never launched) fails its future so nobody waits on it forever.
+    template<typename Func, typename State>
+    struct FutureRunner {
+        FutureRunner(Func&& f, const std::shared_ptr<State>& s, const std::shared_ptr<TaskHandle>& h)
+            : func(std::move(f)), state(s), handle(h) {}
+
+        FutureRunner(FutureRunner&&) = default;
+
+        ~FutureRunner() {
+            if (state) {
+                state->fail();
+            }
+        }
+
+        void operator()() {
+            executeFuture(func, *state, handle);
+        }
+
+        Func func;
+        std::shared_ptr<State> state;
+        std::shared_ptr<TaskHandle> handle;
+    };
+
+    // Fallback for runAfter when the timer pool is exhausted.
+    struct DelayedStart {
+        DelayedStart(uint32_t ms, TaskFunction* fn) : delayMs(ms), inner(fn) {}
+
+        void operator()() {
+            vTaskDelay(pdMS_TO_TICKS(delayMs));
+            (*inner)();
+        }
+
+        uint32_t delayMs;
+        std::unique_ptr<TaskFunction> inner;
+    };
+
+    template<typename Callback>
+    struct VoidCallback {
+        explicit VoidCallback(Callback&& cb) : callback(std::move(cb)) {}
+
+        void operator()() {
+            ASYNC_LOGD("Executing void callback");
+            callback();
+        }
+
+        Callback callback;
+    };
+
+    std::shared_ptr<TaskHandle> handle;
+    TaskConfig config;
+    TaskFunction taskFunc;
+
+    // Runs on the killer once the victim is suspended and off-CPU, so the
+    // body can never touch the job again. Blocks the body held are lost.
+    static void reclaimDedicated(void* param, TaskHandle_t victim) {
+        vTaskDelete(victim);
+        delete static_cast<DedicatedJob*>(param);
+    }
+
+    template<typename Func>
+    static void runPeriodic(Func& func, const std::shared_ptr<TaskHandle>& h, TickType_t period) {
+        if (h->isCancelled() || !h->markStarted()) {
+            h->setState(TaskState::Cancelled);
+            return;
+        }
+
+        // Stats are kept locally and published once per iteration so the
+        // owner can snapshot them without racing the task.
+        SharedState<PeriodicStats>& shared = *h->periodicStats();
+        PeriodicStats stats = shared.load();
+        TickType_t lastWake = xTaskGetTickCount();
+        uint32_t expectedUs = micros();
+
+        while (!h->isCancelled()) {
+            uint32_t startUs = micros();
+            try {
+                TaskBody<Func>::invoke(func, h.get());
+            } catch (...) {
+                ASYNC_LOGE("Periodic task failed with exception");
+                h->finishRun();
+                h->setState(TaskState::Failed);
+                return;
+            }
+            stats.record(micros() - startUs, (int32_t)(startUs - expectedUs));
+            ASYNC_TRACE_EVENT(TraceEvent::Run, h->getName(), stats.runs == 1 ? h->traceId() : 0, startUs);
+
+            TickType_t elapsed = xTaskGetTickCount() - lastWake;
+            if (elapsed >= period) {
+                uint32_t late = elapsed / period;
+                stats.overruns++;
+                stats.missedPeriods += late - 1;
+                lastWake += period * (late - 1);
+                expectedUs += stats.periodUs * late;
+                ASYNC_LOGW("Periodic task overran its period, %u missed", (unsigned)(late - 1));
+            } else {
+                expectedUs += stats.periodUs;
+            }
+            shared.publish(stats);
+            vTaskDelayUntil(&lastWake, period);
+        }
+
+        h->finishRun();
+        h->setState(TaskState::Cancelled);
+    }
+
+    template<typename Func, typename State>
+    static void executeFuture(Func& func, State& state, const std::shared_ptr<TaskHandle>& h) {
+        if (h->isCancelled() || !h->markStarted()) {
+            h->setState(TaskState::Cancelled);
+            state.fail();
+            return;
+        }
+
+        try {
+            auto call = [&]() { return TaskBody<Func>::invoke(func, h.get()); };
+            auto result = FutureValue<typename TaskBody<Func>::Result>::compute(call);
+            h->finishRun();
+            if (h->isCancelled() || !h->setState(TaskState::Completed)) {
+                h->setState(TaskState::Cancelled);
+                state.fail();
+                return;
+            }
+            state.resolve(std::move(result));
+        } catch (...) {
+            h->finishRun();
+            ASYNC_LOGE("Task failed with exception");
+            h->setState(TaskState::Failed);
+            state.fail();
+        }
+    }
+
+    template<typename Func, typename Callback>
+    static void executeTask(Func& func, Callback& callback, const std::shared_ptr<TaskHandle>& h, 
+                          bool executeInLoop, CallbackPriority priority, void*) {
+        ASYNC_LOGD("Executing void task...");
+        
+        if (h->isCancelled() || !h->markStarted()) {
+            ASYNC_LOGD("Task was cancelled before execution");
+            h->setState(TaskState::Cancelled);
+            return;
+        }
+
+        try {
+            TaskBody<Func>::invoke(func, h.get());
+            h->finishRun();
+            
+            if (!h->isCancelled() && h->setState(TaskState::Completed)) {
+                VoidCallback<Callback> callbackWrapper(std::move(callback));
+
+                if (executeInLoop) {
+                    CallbackQueue::instance().enqueue(std::move(callbackWrapper), priority);
+                } else {
+                    callbackWrapper();
+                }
+            } else {
+                h->setState(TaskState::Cancelled);
+            }
+        } catch (...) {
+            h->finishRun();
+            ASYNC_LOGE("Task failed with exception");
+            h->setState(TaskState::Failed);
+        }
+    }
+
+    // Queued callback that carries the task's result inside the callback
+    // record itself, so small results never touch the heap.
+    template<typename Callback, typename ResultType>
+    struct InlineResultCallback {
+        InlineResultCallback(Callback&& cb, ResultType&& value)
+            : callback(std::move(cb)), result(std::move(value)) {}
+
+        void operator()() {
+            ASYNC_LOGD("Executing callback with result");
+            callback(result);
+        }
+
+        Callback callback;
+        ResultType result;
+    };
+
+    // Fallback for results too large for ASYNC_CALLBACK_CAPACITY: one
+    // unshared allocation.
+    template<typename Callback, typename ResultType>
+    struct HeapResultCallback {
+        HeapResultCallback(Callback&& cb, ResultType&& value)
+            : callback(std::move(cb)), result(new ResultType(std::move(value))) {}
+
+        void operator()() {
+            ASYNC_LOGD("Executing callback with heap result");
+            callback(*result);
+        }
+
+        Callback callback;
+        std::unique_ptr<ResultType> result;
+    };
+
+    template<typename Callback, typename ResultType>
+    using ResultCallbackFor = typename std::conditional<
+        sizeof(InlineResultCallback<Callback, ResultType>) <= ASYNC_CALLBACK_CAPACITY &&
+            alignof(InlineResultCallback<Callback, ResultType>) <= alignof(std::max_align_t),
+        InlineResultCallback<Callback, ResultType>,
+        HeapResultCallback<Callback, ResultType>>::type;
+
+    template<typename Func, typename Callback, typename ResultType>
+    static void executeTask(Func& func, Callback& callback, const std::shared_ptr<TaskHandle>& h, 
+                          bool executeInLoop, CallbackPriority priority, ResultType*) {
+        ASYNC_LOGD("Executing task with return type...");
+        
+        if (h->isCancelled() || !h->markStarted()) {
+            ASYNC_LOGD("Task was cancelled before execution");
+            h->setState(TaskState::Cancelled);
+            return;
+        }
+
+        try {
+            ResultType result = TaskBody<Func>::invoke(func, h.get());
+            h->finishRun();
+            
+            if (!h->isCancelled() && h->setState(TaskState::Completed)) {
+                if (executeInLoop) {
+                    CallbackQueue::instance().enqueue(
+                        ResultCallbackFor<Callback, ResultType>(std::move(callback), std::move(result)),
+                        priority);
+                } else {
+                    ASYNC_LOGD("Executing callback with result");
+                    callback(result);
+                }
+            } else {
+                h->setState(TaskState::Cancelled);
+            }
+        } catch (...) {
+            h->finishRun();
+            ASYNC_LOGE("Task failed with exception");
+            h->setState(TaskState::Failed);
+        }
+    }
+};
+
+enum class FutureStatus : uint8_t {
+    Pending,
+    Ready,
+    Failed
+};
+
+template<typename T>
+class FutureState {
+public:
+    using Value = typename FutureValue<T>::Type;
+
+    FutureState() {}
+
+    ~FutureState() {
+        if (status() == FutureStatus::Ready) {
+            value().~Value();
+        }
+    }
+
+    FutureState(const FutureState&) = delete;
+    FutureState& operator=(const FutureState&) = delete;
+
+    FutureStatus status() const {
+        return (FutureStatus)statusValue.load(std::memory_order_acquire);
+    }
+
+    Value& value() {
+        return *reinterpret_cast<Value*>(storage);
+    }
+
+    // Throws FutureError unless the future is ready.
+    typename FutureValue<T>::Ref result() {
+        if (status() != FutureStatus::Ready) {
+            throw FutureError();
+        }
+        return FutureValue<T>::unwrap(value());
+    }
+
+    bool resolve(Value&& result) {
+        if (claimed.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+        new (storage) Value(std::move(result));
+        publish(FutureStatus::Ready);
+        return true;
+    }
+
+    bool fail() {
+        if (claimed.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+        publish(FutureStatus::Failed);
+        return true;
+    }
+
+    bool setContinuation(TaskFunction&& fn) {
+        if (flags.load(std::memory_order_acquire) & HasContinuation) {
+            return false;
+        }
+        continuation = std::move(fn);
+        uint8_t prev = flags.fetch_or(HasContinuation, std::memory_order_acq_rel);
+        if (prev & Done) {
+            runContinuation();
+        }
+        return true;
+    }
+
+    bool wait(uint32_t timeoutMs) {
+        if (status() != FutureStatus::Pending) {
+            return true;
+        }
+
+        TickType_t ticks = timeoutMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+        TickType_t start = xTaskGetTickCount();
+        StaticSemaphore_t semBuffer;
+        SemaphoreHandle_t sem = xSemaphoreCreateBinaryStatic(&semBuffer);
+        SemaphoreHandle_t expected = nullptr;
+        bool registered = waiter.compare_exchange_strong(expected, sem, std::memory_order_acq_rel);
+        bool signalled = false;
+
+        while (status() == FutureStatus::Pending) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (ticks != portMAX_DELAY && elapsed >= ticks) {
+                break;
+            }
+            TickType_t remaining = ticks == portMAX_DELAY ? portMAX_DELAY : ticks - elapsed;
+            if (registered) {
+                if (xSemaphoreTake(sem, remaining) == pdTRUE) {
+                    signalled = true;
+                    break;
+                }
+            } else {
+                vTaskDelay(1);
+            }
+        }
+
+        if (registered) {
+            SemaphoreHandle_t mine = sem;
+            if (!waiter.compare_exchange_strong(mine, nullptr, std::memory_order_acq_rel) &&
+                !signalled) {
+                xSemaphoreTake(sem, portMAX_DELAY);
+            }
+        }
+        vSemaphoreDelete(sem);
+        return status() != FutureStatus::Pending;
+    }
+
+private:
+    enum : uint8_t {
+        Done = 1,
+        HasContinuation = 2
+    };
+
+    alignas(Value) unsigned char storage[sizeof(Value)];
+    std::atomic<uint8_t> statusValue{(uint8_t)FutureStatus::Pending};
+    std::atomic<bool> claimed{false};
+    std::atomic<uint8_t> flags{0};
+    std::atomic<SemaphoreHandle_t> waiter{nullptr};
+    TaskFunction continuation;
+
+    void publish(FutureStatus result) {
+        statusValue.store((uint8_t)result, std::memory_order_release);
+        if (SemaphoreHandle_t sem = waiter.exchange(nullptr, std::memory_order_acq_rel)) {
+            xSemaphoreGive(sem);
+        }
+        uint8_t prev = flags.fetch_or(Done, std::memory_order_acq_rel);
+        if (prev & HasContinuation) {
+            runContinuation();
+        }
+    }
+
+    void runContinuation() {
+        TaskFunction fn = std::move(continuation);
+        try {
+            fn();
+        } catch (...) {
+            ASYNC_LOGE("Exception in future continuation");
+        }
+    }
+};
+
+#if ASYNC_HAS_COROUTINES
+class CoroutineScheduler {
+public:
+    static void resumeOnWorker(std::coroutine_handle<> h, BaseType_t core = tskNO_AFFINITY) {
+        extern AsyncConfig globalConfig;
+        TaskFunction job = [h]() { h.resume(); };
+        if (!WorkerPool::instance().submit(job, core, globalConfig.defaultPriority)) {
+            h.resume();
+        }
+    }
+
+    static void resumeInLoop(std::coroutine_handle<> h) {
+        if (!CallbackQueue::instance().enqueue([h]() { h.resume(); })) {
+            h.resume();
+        }
+    }
+};
+
+template<typename T>
+struct FutureAwaitable {
+    std::shared_ptr<FutureState<T>> state;
+
+    bool await_ready() const {
+        return !state || state->status() != FutureStatus::Pending;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        if (!state->setContinuation([h]() { h.resume(); })) {
+            h.resume();
+        }
+    }
+
+    // A failed or empty future throws FutureError into the awaiting
+    // coroutine, which fails its own AsyncTask unless it catches it.
+    T await_resume() {
+        if (!state) {
+            throw FutureError();
+        }
+        state->result();
+        return FutureValue<T>::take(state->value());
+    }
+};
+
+struct DelayAwaitable {
+    explicit DelayAwaitable(uint32_t ms) : delayMs(ms) {}
+
+    uint32_t delayMs;
+
+    bool await_ready() const {
+        return delayMs == 0;
+    }
+
+    // With the timer pool exhausted the frame waits on the timer task's
+    // overflow list instead of blocking the worker it runs on.
+    void await_suspend(std::coroutine_handle<> h) {
+        uint32_t ms = delayMs;
+        TimerService& timers = TimerService::instance();
+        TaskFunction resume = [h]() { CoroutineScheduler::resumeOnWorker(h); };
+        if (timers.schedule(ms, resume) != 0) {
+            return;
+        }
+        waiter.fire = &DelayAwaitable::wake;
+        waiter.context = h.address();
+        if (!timers.schedule(ms, waiter)) {
+            vTaskDelay(pdMS_TO_TICKS(ms));
+            h.resume();
+        }
+    }
+
+    void await_resume() {}
+
+    static void wake(void* frame) {
+        CoroutineScheduler::resumeOnWorker(std::coroutine_handle<>::from_address(frame));
+    }
+
+    TimerService::Waiter waiter;
+};
+
+struct LoopAwaitable {
+    bool await_ready() const {
+        return false;
+    }
 
-#ifdef ASYNC_DEBUG
-    #define ASYNC_LOG(fmt, ...) Serial.printf("[EasyAsync] " fmt "\n", ##__VA_ARGS__)
-#else
-    #define ASYNC_LOG(fmt, ...)
-#endif
+    void await_suspend(std::coroutine_handle<> h) {
+        CoroutineScheduler::resumeInLoop(h);
+    }
 
-struct AsyncConfig {
-    uint32_t defaultStackSize = 4096;
-    UBaseType_t defaultPriority = 1;
-    BaseType_t defaultCore = tskNO_AFFINITY;
-    uint16_t maxConcurrentTasks = 10;
-    bool executeCallbacksInLoop = true;
+    void await_resume() {}
 };
 
-enum class TaskState {
-    Pending,
-    Running,
-    Completed,
-    Failed,
-    Cancelled
+struct WorkerAwaitable {
+    BaseType_t core;
+
+    bool await_ready() const {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        CoroutineScheduler::resumeOnWorker(h, core);
+    }
+
+    void await_resume() {}
 };
+#endif
 
-class CallbackQueue {
+// Body of Future::then: applies fn to the source value and resolves next.
+template<typename T, typename U, typename Func>
+struct FutureContinuation {
+    FutureContinuation(Func&& f, const std::shared_ptr<FutureState<U>>& n, FutureState<T>* s)
+        : fn(std::move(f)), next(n), self(s) {}
+
+    void operator()() {
+        if (self->status() != FutureStatus::Ready) {
+            next->fail();
+            return;
+        }
+        try {
+            auto call = [&]() { return FutureValue<T>::apply(fn, self->value()); };
+            next->resolve(FutureValue<U>::compute(call));
+        } catch (...) {
+            next->fail();
+        }
+    }
+
+    Func fn;
+    std::shared_ptr<FutureState<U>> next;
+    FutureState<T>* self;
+};
+
+template<typename T>
+class Future {
 public:
-    static CallbackQueue& instance() {
-        static CallbackQueue instance;
-        return instance;
+    using State = FutureState<T>;
+
+    Future() {}
+
+    Future(std::shared_ptr<State> state, std::shared_ptr<TaskHandle> task = nullptr)
+        : state(std::move(state)), task(std::move(task)) {}
+
+    bool valid() const {
+        return state != nullptr;
+    }
+
+    bool ready() const {
+        return state && state->status() == FutureStatus::Ready;
     }
 
-    void enqueue(std::function<void()> callback) {
-        if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-            queue.push(callback);
-            xSemaphoreGive(mutex);
-            ASYNC_LOG("Callback enqueued. Queue size: %d", queue.size());
+    bool failed() const {
+        return !state || state->status() == FutureStatus::Failed;
+    }
+
+    bool wait(uint32_t timeoutMs = portMAX_DELAY) const {
+        return state && state->wait(timeoutMs);
+    }
+
+    // Blocks until the future settles and returns a reference to its value,
+    // so move-only results can be moved out. Throws FutureError if it failed
+    // or is empty.
+    typename FutureValue<T>::Ref get() const {
+        if (!state) {
+            throw FutureError();
         }
+        state->wait(portMAX_DELAY);
+        return state->result();
     }
 
-    void process() {
-        if (xSemaphoreTake(mutex, 0) == pdTRUE) {
-            while (!queue.empty()) {
-                auto callback = queue.front();
-                queue.pop();
-                xSemaphoreGive(mutex);
-                
-                ASYNC_LOG("Processing callback...");
-                callback();
-                
-                if (xSemaphoreTake(mutex, portMAX_DELAY) != pdTRUE) {
-                    return;
-                }
-            }
-            xSemaphoreGive(mutex);
+    template<typename U = T>
+    typename std::enable_if<!std::is_void<U>::value, bool>::type
+    get(U& out, uint32_t timeoutMs) const {
+        if (!wait(timeoutMs) || !ready()) {
+            return false;
         }
+        out = state->value();
+        return true;
     }
 
-    size_t size() {
-        size_t sz = 0;
-        if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-            sz = queue.size();
-            xSemaphoreGive(mutex);
+    template<typename Func>
+    auto then(Func fn) -> Future<decltype(FutureValue<T>::apply(fn, std::declval<typename State::Value&>()))> {
+        using U = decltype(FutureValue<T>::apply(fn, std::declval<typename State::Value&>()));
+        if (!state) {
+            return Future<U>();
+        }
+
+        auto next = std::make_shared<FutureState<U>>();
+        bool attached = state->setContinuation(
+            FutureContinuation<T, U, Func>(std::move(fn), next, state.get()));
+        if (!attached) {
+            ASYNC_LOGE("Future already has a continuation");
+            next->fail();
         }
-        return sz;
+        return Future<U>(next);
     }
 
-private:
-    CallbackQueue() {
-        mutex = xSemaphoreCreateMutex();
+    void cancel() {
+        if (task) {
+            task->cancel();
+        }
+        if (state) {
+            state->fail();
+        }
     }
 
-    ~CallbackQueue() {
-        if (mutex) {
-            vSemaphoreDelete(mutex);
+#if ASYNC_HAS_COROUTINES
+    FutureAwaitable<T> operator co_await() const {
+        return FutureAwaitable<T>{state};
+    }
+#endif
+
+private:
+    friend class Async;
+
+    std::shared_ptr<State> state;
+    std::shared_ptr<TaskHandle> task;
+};
+
+// Shared by the continuations WhenAll attaches: each stores its input's
+// value and counts down; the last one publishes the combined result.
+template<typename Result>
+struct WhenAllState {
+    explicit WhenAllState(size_t count)
+        : remaining(count), result(std::make_shared<FutureState<Result>>()) {}
+
+    void arrive() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            result->resolve(std::move(values));
         }
     }
 
-    std::queue<std::function<void()>> queue;
-    SemaphoreHandle_t mutex;
+    Result values;
+    std::atomic<size_t> remaining;
+    std::shared_ptr<FutureState<Result>> result;
 };
 
-struct TaskConfig {
-    uint32_t stackSize = 0;
-    UBaseType_t priority = 0;
-    BaseType_t core = tskNO_AFFINITY;
-    const char* name = nullptr;
-    uint32_t timeoutMs = 0;
-    bool executeInLoop = true;
+struct WhenAnyState {
+    explicit WhenAnyState(size_t count)
+        : failures(count), result(std::make_shared<FutureState<size_t>>()) {}
+
+    void arrive(size_t index, bool ready) {
+        if (ready) {
+            result->resolve(std::move(index));
+        } else if (failures.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            result->fail();
+        }
+    }
+
+    std::atomic<size_t> failures;
+    std::shared_ptr<FutureState<size_t>> result;
 };
 
-class TaskHandle {
-public:
-    TaskHandle() : taskHandle(nullptr), state(TaskState::Pending), 
-                   cancelled(false), startTime(0), endTime(0) {}
+#if ASYNC_HAS_COROUTINES
+template<typename T>
+class AsyncTask;
 
-    void setHandle(TaskHandle_t handle) { 
-        taskHandle = handle; 
-        state = TaskState::Running;
-        startTime = millis();
-        ASYNC_LOG("Task started at %lu ms", startTime);
+template<typename T>
+struct AsyncTaskPromiseBase {
+    std::shared_ptr<FutureState<T>> state = std::make_shared<FutureState<T>>();
+
+    AsyncTask<T> get_return_object() {
+        return AsyncTask<T>(state);
     }
 
-    TaskHandle_t getHandle() const { return taskHandle; }
-    
-    TaskState getState() const { return state; }
-    
-    void setState(TaskState newState) { 
-        state = newState;
-        if (newState == TaskState::Completed || 
-            newState == TaskState::Failed || 
-            newState == TaskState::Cancelled) {
-            endTime = millis();
-            ASYNC_LOG("Task ended at %lu ms. Duration: %lu ms", endTime, endTime - startTime);
-        }
+    WorkerAwaitable initial_suspend() noexcept {
+        return WorkerAwaitable{tskNO_AFFINITY};
     }
 
-    bool isCancelled() const { return cancelled; }
-    
-    void cancel() {
-        cancelled = true;
-        if (taskHandle != nullptr && state == TaskState::Running) {
-            setState(TaskState::Cancelled);
-            vTaskDelete(taskHandle);
-            taskHandle = nullptr;
-            ASYNC_LOG("Task cancelled");
-        }
+    std::suspend_never final_suspend() noexcept {
+        return {};
     }
 
-    bool isRunning() const { 
-        return state == TaskState::Running && !cancelled; 
+    void unhandled_exception() {
+        ASYNC_LOGE("Coroutine failed with exception");
+        state->fail();
     }
+};
 
-    uint32_t getExecutionTime() const {
-        if (startTime == 0) return 0;
-        if (endTime == 0) return millis() - startTime;
-        return endTime - startTime;
+template<typename T>
+struct AsyncTaskPromise : AsyncTaskPromiseBase<T> {
+    void return_value(T value) {
+        this->state->resolve(std::move(value));
     }
+};
 
-private:
-    TaskHandle_t taskHandle;
-    TaskState state;
-    bool cancelled;
-    uint32_t startTime;
-    uint32_t endTime;
+template<>
+struct AsyncTaskPromise<void> : AsyncTaskPromiseBase<void> {
+    void return_void() {
+        state->resolve(Unit());
+    }
 };
 
-class Task {
+template<typename T = void>
+class AsyncTask : public Future<T> {
 public:
-    Task() : handle(std::make_shared<TaskHandle>()), config() {}
+    using promise_type = AsyncTaskPromise<T>;
 
-    Task(const Task&) = delete;
-    Task& operator=(const Task&) = delete;
-    
-    Task(Task&& other) noexcept : handle(std::move(other.handle)), 
-                                   config(other.config),
-                                   taskFunc(std::move(other.taskFunc)) {}
-    
-    Task& operator=(Task&& other) noexcept {
-        if (this != &other) {
-            handle = std::move(other.handle);
-            config = other.config;
-            taskFunc = std::move(other.taskFunc);
-        }
-        return *this;
-    }
+    AsyncTask() {}
 
-    template<typename Func, typename Callback>
-    Task(Func func, Callback callback, const TaskConfig& cfg) 
-        : handle(std::make_shared<TaskHandle>()), config(cfg) {
-        using ResultType = decltype(func());
-        taskFunc = [func, callback, h = handle, cfg]() {
-            executeTask(func, callback, h, cfg, (ResultType*)nullptr);
-        };
-    }
+    explicit AsyncTask(std::shared_ptr<FutureState<T>> state) : Future<T>(std::move(state)) {}
+};
+#endif
 
-    bool run() {
-        if (!taskFunc) {
-            ASYNC_LOG("ERROR: Task function is null");
-            return false;
-        }
+AsyncConfig globalConfig;
 
-        static uint32_t taskCounter = 0;
-        char taskName[16];
-        if (config.name == nullptr) {
-            snprintf(taskName, sizeof(taskName), "Task_%lu", taskCounter++);
-            config.name = taskName;
+class Async {
+public:
+    static void setConfig(const AsyncConfig& config) {
+        globalConfig = config;
+#ifdef ASYNC_LOG_DEFERRED
+        AsyncLog::instance().startFlusher();
+#endif
+        StaticStackPool::instance().configure(config);
+        CallbackQueue::instance().configure(config);
+        if (config.callbackDispatcher) {
+            CallbackQueue::instance().startDispatcher(config.dispatcherCore, config.dispatcherPriority,
+                                                      config.dispatcherStackSize);
+        } else {
+            CallbackQueue::instance().stopDispatcher();
         }
+        ASYNC_LOGI("Global config updated");
+    }
 
-        extern AsyncConfig globalConfig;
-        uint32_t stackSize = config.stackSize > 0 ? config.stackSize : globalConfig.defaultStackSize;
-        UBaseType_t priority = config.priority > 0 ? config.priority : globalConfig.defaultPriority;
-        BaseType_t core = config.core != tskNO_AFFINITY ? config.core : globalConfig.defaultCore;
+    static StackPoolStats stackPoolStats() {
+        return StaticStackPool::instance().stats();
+    }
 
-        auto wrapper = [](void* param) {
-            auto* func = static_cast<std::function<void()>*>(param);
-            try {
-                (*func)();
-            } catch (...) {
-                ASYNC_LOG("ERROR: Exception in task");
-            }
-            delete func;
-            vTaskDelete(NULL);
-        };
+    static void loadStackHints(const StackHint* hints, size_t count) {
+        StackProfiler::instance().load(hints, count);
+    }
 
-        auto* funcCopy = new std::function<void()>(taskFunc);
-        TaskHandle_t taskHandle = nullptr;
+    static void dumpStackProfile(Print& out = Serial) {
+        StackProfiler::instance().dump(out, globalConfig.learnedStackMargin);
+    }
 
-        BaseType_t result;
-        if (core != tskNO_AFFINITY) {
-            result = xTaskCreatePinnedToCore(wrapper, config.name, stackSize, 
-                                            funcCopy, priority, &taskHandle, core);
-            ASYNC_LOG("Creating task '%s' on core %d (stack: %u, priority: %u)", 
-                     config.name, core, stackSize, priority);
-        } else {
-            result = xTaskCreate(wrapper, config.name, stackSize, 
-                               funcCopy, priority, &taskHandle);
-            ASYNC_LOG("Creating task '%s' on any core (stack: %u, priority: %u)", 
-                     config.name, stackSize, priority);
+    // No-op while AsyncConfig::callbackDispatcher runs the callbacks.
+    static void update() {
+        CallbackQueue& queue = CallbackQueue::instance();
+        if (globalConfig.executeCallbacksInLoop && !queue.dispatching()) {
+            queue.process();
         }
+    }
 
-        if (result != pdPASS) {
-            ASYNC_LOG("ERROR: Failed to create task");
-            delete funcCopy;
-            handle->setState(TaskState::Failed);
-            return false;
+    // Budgeted drain for latency-sensitive loops; returns callbacks left.
+    static size_t update(uint32_t maxMicros, uint32_t maxCallbacks = 0) {
+        CallbackQueue& queue = CallbackQueue::instance();
+        if (!globalConfig.executeCallbacksInLoop || queue.dispatching()) {
+            return 0;
         }
+        return queue.process(maxMicros, maxCallbacks);
+    }
 
-        handle->setHandle(taskHandle);
-        return true;
+    // For loop()-driven users: sleeps until a callback is queued instead of
+    // spinning. Returns true if callbacks are waiting.
+    static bool waitForCallbacks(uint32_t timeoutMs) {
+        TickType_t ticks = timeoutMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+        return CallbackQueue::instance().waitForWork(ticks);
     }
 
-    void cancel() {
-        if (handle) {
-            handle->cancel();
-        }
+    static const UpdateStats& lastUpdateStats() {
+        return CallbackQueue::instance().lastUpdate();
     }
 
-    TaskState getState() const {
-        return handle ? handle->getState() : TaskState::Failed;
+    static CallbackClassStats callbackStats(CallbackPriority priority) {
+        return CallbackQueue::instance().classStats(priority);
     }
 
-    bool isRunning() const {
-        return handle ? handle->isRunning() : false;
+    static size_t pendingCallbacks() {
+        return CallbackQueue::instance().size();
     }
 
-    bool isCancelled() const {
-        return handle ? handle->isCancelled() : false;
+    static uint32_t droppedCallbacks() {
+        return CallbackQueue::instance().droppedCount();
     }
 
-    uint32_t getExecutionTime() const {
-        return handle ? handle->getExecutionTime() : 0;
+    static size_t pendingTimers() {
+        return TimerService::instance().pending();
     }
 
-private:
-    std::shared_ptr<TaskHandle> handle;
-    TaskConfig config;
-    std::function<void()> taskFunc;
+    static AdmissionStats admissionStats() {
+        return AdmissionControl::instance().stats();
+    }
 
-    template<typename Func, typename Callback>
-    static void executeTask(Func func, Callback callback, std::shared_ptr<TaskHandle> h, 
-                          const TaskConfig& cfg, void*) {
-        ASYNC_LOG("Executing void task...");
-        
-        if (h->isCancelled()) {
-            ASYNC_LOG("Task was cancelled before execution");
+    static uint32_t timedOutTasks() {
+        return TaskHandle::timeoutCount();
+    }
+
+private:
+    // Calls onDone with the input's state once it is ready, or with nullptr
+    // if it failed, is empty or already has a continuation.
+    template<typename T, typename OnDone>
+    static void watchFuture(const std::shared_ptr<FutureState<T>>& input, OnDone onDone) {
+        if (!input) {
+            onDone(nullptr);
             return;
         }
-
-        try {
-            func();
-            
-            if (!h->isCancelled()) {
-                h->setState(TaskState::Completed);
-                
-                auto callbackWrapper = [callback]() {
-                    ASYNC_LOG("Executing void callback");
-                    callback();
-                };
-
-                if (cfg.executeInLoop) {
-                    CallbackQueue::instance().enqueue(callbackWrapper);
-                } else {
-                    callbackWrapper();
-                }
-            }
-        } catch (...) {
-            ASYNC_LOG("Task failed with exception");
-            h->setState(TaskState::Failed);
+        FutureState<T>* self = input.get();
+        bool attached = input->setContinuation([onDone, self]() mutable {
+            onDone(self->status() == FutureStatus::Ready ? self : nullptr);
+        });
+        if (!attached) {
+            ASYNC_LOGE("Future already has a continuation");
+            onDone(nullptr);
         }
     }
 
-    template<typename Func, typename Callback, typename ResultType>
-    static void executeTask(Func func, Callback callback, std::shared_ptr<TaskHandle> h, 
-                          const TaskConfig& cfg, ResultType*) {
-        ASYNC_LOG("Executing task with return type...");
-        
-        if (h->isCancelled()) {
-            ASYNC_LOG("Task was cancelled before execution");
-            return;
-        }
+    template<size_t I, typename Shared>
+    static void whenAllWatch(const std::shared_ptr<Shared>&) {}
 
-        try {
-            auto result = std::make_shared<ResultType>(func());
-            
-            if (!h->isCancelled()) {
-                h->setState(TaskState::Completed);
-                
-                auto callbackWrapper = [callback, result]() {
-                    ASYNC_LOG("Executing callback with result");
-                    callback(*result);
-                };
-
-                if (cfg.executeInLoop) {
-                    CallbackQueue::instance().enqueue(callbackWrapper);
-                } else {
-                    callbackWrapper();
-                }
+    template<size_t I, typename Shared, typename T, typename... Rest>
+    static void whenAllWatch(const std::shared_ptr<Shared>& shared, const Future<T>& first,
+                             const Future<Rest>&... rest) {
+        watchFuture(first.state, [shared](FutureState<T>* done) {
+            if (done == nullptr) {
+                shared->result->fail();
+                return;
             }
-        } catch (...) {
-            ASYNC_LOG("Task failed with exception");
-            h->setState(TaskState::Failed);
-        }
+            std::get<I>(shared->values) = done->value();
+            shared->arrive();
+        });
+        whenAllWatch<I + 1>(shared, rest...);
     }
-};
 
-AsyncConfig globalConfig;
+    template<size_t I>
+    static void whenAnyWatch(const std::shared_ptr<WhenAnyState>&) {}
 
-class Async {
-public:
-    static void setConfig(const AsyncConfig& config) {
-        globalConfig = config;
-        ASYNC_LOG("Global config updated");
+    template<size_t I, typename T, typename... Rest>
+    static void whenAnyWatch(const std::shared_ptr<WhenAnyState>& shared, const Future<T>& first,
+                             const Future<Rest>&... rest) {
+        watchFuture(first.state, [shared](FutureState<T>* done) {
+            shared->arrive(I, done != nullptr);
+        });
+        whenAnyWatch<I + 1>(shared, rest...);
     }
 
-    static void update() {
-        if (globalConfig.executeCallbacksInLoop) {
-            CallbackQueue::instance().process();
+    static size_t parallelGrain(size_t count, size_t grain) {
+        if (grain > 0) {
+            return grain;
         }
+        size_t target = portNUM_PROCESSORS * 4;
+        return count > target ? (count + target - 1) / target : 1;
     }
 
-    static size_t pendingCallbacks() {
-        return CallbackQueue::instance().size();
+public:
+
+#ifdef ASYNC_TRACE
+    static void dumpTrace(Print& out = Serial) {
+        AsyncTrace::instance().dump(out);
+    }
+#endif
+
+    template<typename Func>
+    static Future<typename TaskBody<Func>::Result> Run(Func func, const TaskConfig& config = TaskConfig()) {
+        using ResultType = typename TaskBody<Func>::Result;
+        auto state = std::make_shared<FutureState<ResultType>>();
+        Task task = Task::forFuture(std::move(func), state, config);
+        Future<ResultType> future(state, task.getHandle());
+        if (!task.run()) {
+            state->fail();
+        }
+        return future;
     }
 
     template<typename Func, typename Callback>
@@ -363,14 +4301,14 @@ public:
 
     template<typename Func, typename Callback>
     static Task Run(Func func, Callback cb, const TaskConfig& config) {
-        Task task(func, cb, config);
+        Task task(std::move(func), std::move(cb), config);
         task.run();
         return task;
     }
 
     template<typename Func, typename Callback>
     static Task Create(Func func, Callback cb, const TaskConfig& config = TaskConfig()) {
-        return Task(func, cb, config);
+        return Task(std::move(func), std::move(cb), config);
     }
 
     template<typename Func>
@@ -382,11 +4320,146 @@ public:
     template<typename Func, typename Callback>
     static Task RunAfter(uint32_t delayMs, Func func, Callback cb, 
                         const TaskConfig& config = TaskConfig()) {
-        auto delayedFunc = [delayMs, func]() {
-            vTaskDelay(pdMS_TO_TICKS(delayMs));
-            return func();
+        Task task(std::move(func), std::move(cb), config);
+        task.runAfter(delayMs);
+        return task;
+    }
+
+#if ASYNC_HAS_COROUTINES
+    static DelayAwaitable Delay(uint32_t delayMs) {
+        return DelayAwaitable{delayMs};
+    }
+
+    static LoopAwaitable SwitchToLoop() {
+        return LoopAwaitable{};
+    }
+
+    static WorkerAwaitable SwitchToWorker(BaseType_t core = tskNO_AFFINITY) {
+        return WorkerAwaitable{core};
+    }
+#endif
+
+    // fn(i) for every i in [begin, end), split into chunks of at least
+    // grain indices (0 picks a grain from the range size). Returns false if
+    // any chunk threw.
+    template<typename Func>
+    static bool ParallelFor(size_t begin, size_t end, size_t grain, Func fn) {
+        if (end <= begin) {
+            return true;
+        }
+        size_t count = end - begin;
+        grain = parallelGrain(count, grain);
+        auto chunk = [&](size_t c) {
+            size_t first = begin + c * grain;
+            size_t last = first + grain < end ? first + grain : end;
+            for (size_t i = first; i < last; i++) {
+                fn(i);
+            }
+        };
+        return ParallelJob::run((count + grain - 1) / grain, chunk);
+    }
+
+    template<typename In, typename Out, typename Func>
+    static bool ParallelMap(const In* input, Out* output, size_t count, size_t grain, Func fn) {
+        return ParallelFor(0, count, grain, [&](size_t i) { output[i] = fn(input[i]); });
+    }
+
+    // Combines per-chunk partials in chunk order, so the result does not
+    // depend on scheduling. Returns identity if any chunk threw.
+    template<typename T, typename Map, typename Combine>
+    static T ParallelReduce(size_t begin, size_t end, size_t grain, T identity,
+                            Map map, Combine combine) {
+        if (end <= begin) {
+            return identity;
+        }
+        size_t count = end - begin;
+        grain = parallelGrain(count, grain);
+        size_t chunks = (count + grain - 1) / grain;
+        ReducePartials<T> partials(chunks, identity);
+        auto chunk = [&](size_t c) {
+            size_t first = begin + c * grain;
+            size_t last = first + grain < end ? first + grain : end;
+            T acc = identity;
+            for (size_t i = first; i < last; i++) {
+                acc = combine(acc, map(i));
+            }
+            partials[c] = acc;
         };
-        return Run(delayedFunc, cb, config);
+        if (!ParallelJob::run(chunks, chunk)) {
+            return identity;
+        }
+        T result = identity;
+        for (size_t c = 0; c < chunks; c++) {
+            result = combine(result, partials[c]);
+        }
+        return result;
+    }
+
+    // Resolves with every input's value once all are ready, or fails as soon
+    // as one fails. Each input gets one continuation and the inputs share a
+    // single countdown, so only the last completion publishes. The inputs
+    // must not already have a then() attached.
+    template<typename... Ts>
+    static Future<std::tuple<typename FutureState<Ts>::Value...>> WhenAll(const Future<Ts>&... futures) {
+        using Result = std::tuple<typename FutureState<Ts>::Value...>;
+        auto shared = std::make_shared<WhenAllState<Result>>(sizeof...(Ts));
+        if (sizeof...(Ts) == 0) {
+            shared->result->resolve(Result());
+        }
+        whenAllWatch<0>(shared, futures...);
+        return Future<Result>(shared->result);
+    }
+
+    template<typename T>
+    static Future<std::vector<typename FutureState<T>::Value>> WhenAll(const Future<T>* futures, size_t count) {
+        using Result = std::vector<typename FutureState<T>::Value>;
+        auto shared = std::make_shared<WhenAllState<Result>>(count);
+        shared->values.resize(count);
+        if (count == 0) {
+            shared->result->resolve(Result());
+        }
+        for (size_t i = 0; i < count; i++) {
+            watchFuture(futures[i].state, [shared, i](FutureState<T>* done) {
+                if (done == nullptr) {
+                    shared->result->fail();
+                    return;
+                }
+                shared->values[i] = done->value();
+                shared->arrive();
+            });
+        }
+        return Future<Result>(shared->result);
+    }
+
+    // Resolves with the index of the first input to become ready; fails only
+    // if every input fails.
+    template<typename... Ts>
+    static Future<size_t> WhenAny(const Future<Ts>&... futures) {
+        auto shared = std::make_shared<WhenAnyState>(sizeof...(Ts));
+        if (sizeof...(Ts) == 0) {
+            shared->result->fail();
+        }
+        whenAnyWatch<0>(shared, futures...);
+        return Future<size_t>(shared->result);
+    }
+
+    template<typename T>
+    static Future<size_t> WhenAny(const Future<T>* futures, size_t count) {
+        auto shared = std::make_shared<WhenAnyState>(count);
+        if (count == 0) {
+            shared->result->fail();
+        }
+        for (size_t i = 0; i < count; i++) {
+            watchFuture(futures[i].state, [shared, i](FutureState<T>* done) {
+                shared->arrive(i, done != nullptr);
+            });
+        }
+        return Future<size_t>(shared->result);
+    }
+
+    template<typename Func>
+    static Task RunEvery(uint32_t periodMs, Func func, const TaskConfig& config = TaskConfig()) {
+        return Task::periodic(periodMs, std::move(func), config);
     }
 
     template<typename Func, typename Callback>
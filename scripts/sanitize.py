@@ -0,0 +1,9 @@
+# Extra script for the native sanitizer envs. The sanitizer runtime has to be
+# linked as well as compiled in, so the flag named by custom_sanitize goes to
+# both the compiler and the linker.
+Import("env")
+
+sanitize = env.GetProjectOption("custom_sanitize", "")
+if sanitize:
+    flags = ["-fsanitize=" + sanitize, "-fno-omit-frame-pointer"]
+    env.Append(CCFLAGS=flags, LINKFLAGS=flags)
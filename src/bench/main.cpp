@@ -0,0 +1,286 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// EasyAsync microbenchmarks. Builds for the device (`pio run -e esp32dev-bench`)
+// and the host (`pio run -e native-bench`) and prints one line per metric:
+// latency percentiles in microseconds, throughput in jobs/s, C++ heap
+// traffic per job as counted by the operator new hook below and, on the
+// device, the drop in free system heap (FreeRTOS stacks and TCBs included).
+// Run is measured on the worker pool and on a dedicated task per job.
+
+#ifndef BENCH_ITERATIONS
+  #define BENCH_ITERATIONS 1000
+#endif
+
+#ifndef BENCH_MAX_PRODUCERS
+  #define BENCH_MAX_PRODUCERS 4
+#endif
+
+#ifndef BENCH_WINDOW
+  #define BENCH_WINDOW 16
+#endif
+
+static std::atomic<uint32_t> allocCount{0};
+static std::atomic<uint32_t> allocBytes{0};
+
+// None of the replacements are inlined: GCC would otherwise see malloc() and
+// free() at the library's new- and delete-expressions and warn about
+// mismatched allocation functions.
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  allocBytes.fetch_add(size, std::memory_order_relaxed);
+  void* p = malloc(size ? size : 1);
+  if(p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+#ifdef ARDUINO
+uint32_t freeHeap(){ return ESP.getFreeHeap(); }
+#else
+uint32_t freeHeap(){ return 0; }
+#endif
+
+// Lowest free system heap seen while waiting on a benchmark.
+std::atomic<uint32_t> heapLow{0};
+
+struct HeapMark{
+  uint32_t count = allocCount.load();
+  uint32_t bytes = allocBytes.load();
+  uint32_t system = freeHeap();
+
+  HeapMark(){ heapLow = system; }
+
+  void report(const char* label, uint32_t jobs) const {
+    uint32_t c = allocCount.load() - count;
+    uint32_t b = allocBytes.load() - bytes;
+    Serial.printf("%-34s allocs/job=%.2f bytes/job=%.1f", label, (double)c / jobs, (double)b / jobs);
+    if(system > 0){
+      Serial.printf(" sys peak=%d retained=%d bytes", (int)(system - heapLow.load()),
+                    (int)(system - freeHeap()));
+    }
+    Serial.println();
+  }
+};
+
+struct Samples{
+  int32_t data[BENCH_ITERATIONS];
+  std::atomic<uint32_t> count{0};
+
+  void reset(){ count = 0; }
+
+  void add(int32_t us){
+    uint32_t i = count.fetch_add(1, std::memory_order_relaxed);
+    if(i < BENCH_ITERATIONS) data[i] = us;
+  }
+
+  // Signed, so a timer that fires early shows up as a negative value.
+  void report(const char* label){
+    uint32_t n = std::min<uint32_t>(count.load(), BENCH_ITERATIONS);
+    if(n == 0){
+      Serial.printf("%-34s no samples\n", label);
+      return;
+    }
+    std::sort(data, data + n);
+    Serial.printf("%-34s n=%u min=%d p50=%d p90=%d p99=%d max=%d us\n", label, (unsigned)n,
+                  (int)data[0], (int)data[n * 50 / 100], (int)data[n * 90 / 100],
+                  (int)data[n * 99 / 100], (int)data[n - 1]);
+  }
+};
+
+Samples startLatency;
+Samples callbackLatency;
+uint32_t finishedAt[BENCH_ITERATIONS];
+std::atomic<uint32_t> completed{0};
+
+void waitFor(uint32_t target){
+  while(completed.load() < target){
+    Async::update();
+    uint32_t heapNow = freeHeap();
+    if(heapNow < heapLow.load()) heapLow = heapNow;
+    taskYIELD();
+  }
+}
+
+// mode is "pool" or "dedicated"; the dedicated run is the spawn-per-task
+// baseline the pool replaced.
+void benchRun(const char* mode, bool dedicated){
+  const uint32_t jobs = dedicated ? BENCH_ITERATIONS / 4 : BENCH_ITERATIONS;
+  TaskConfig cfg;
+  cfg.dedicated = dedicated;
+  char label[40];
+  startLatency.reset();
+  callbackLatency.reset();
+  completed = 0;
+  HeapMark heap;
+  uint32_t began = micros();
+  for(uint32_t i=0;i<jobs;i++){
+    if(i >= BENCH_WINDOW) waitFor(i - BENCH_WINDOW + 1);
+    uint32_t submitted = micros();
+    Async::Run([i, submitted](){
+      uint32_t now = micros();
+      startLatency.add(now - submitted);
+      finishedAt[i] = micros();
+    }, [i](){
+      callbackLatency.add(micros() - finishedAt[i]);
+      completed++;
+    }, cfg);
+  }
+  waitFor(jobs);
+  uint32_t elapsed = micros() - began;
+  snprintf(label, sizeof(label), "Run[%s] submit->start", mode);
+  startLatency.report(label);
+  snprintf(label, sizeof(label), "Run[%s] end->callback", mode);
+  callbackLatency.report(label);
+  snprintf(label, sizeof(label), "Run[%s] heap", mode);
+  heap.report(label, jobs);
+  snprintf(label, sizeof(label), "Run[%s] throughput", mode);
+  Serial.printf("%-34s %.0f jobs/s\n", label, jobs * 1e6 / elapsed);
+}
+
+void benchFireAndForget(){
+  startLatency.reset();
+  completed = 0;
+  HeapMark heap;
+  uint32_t began = micros();
+  for(uint32_t i=0;i<BENCH_ITERATIONS;i++){
+    if(i >= BENCH_WINDOW) waitFor(i - BENCH_WINDOW + 1);
+    uint32_t submitted = micros();
+    Async::RunFireAndForget([submitted](){
+      startLatency.add(micros() - submitted);
+      completed++;
+    });
+  }
+  waitFor(BENCH_ITERATIONS);
+  uint32_t elapsed = micros() - began;
+  startLatency.report("RunFireAndForget submit->start");
+  heap.report("RunFireAndForget heap", BENCH_ITERATIONS);
+  Serial.printf("%-34s %.0f jobs/s\n", "RunFireAndForget throughput", BENCH_ITERATIONS * 1e6 / elapsed);
+}
+
+void benchRunAfter(uint32_t delayMs){
+  const uint32_t jobs = BENCH_ITERATIONS / 4;
+  startLatency.reset();
+  completed = 0;
+  HeapMark heap;
+  for(uint32_t i=0;i<jobs;i++){
+    if(i >= BENCH_WINDOW) waitFor(i - BENCH_WINDOW + 1);
+    uint32_t due = micros() + delayMs * 1000;
+    Async::RunAfter(delayMs, [due](){
+      startLatency.add((int32_t)(micros() - due));
+      completed++;
+    }, NOCALLBACK);
+  }
+  waitFor(jobs);
+  uint32_t n = std::min<uint32_t>(startLatency.count.load(), BENCH_ITERATIONS);
+  uint32_t early = (uint32_t)std::count_if(startLatency.data, startLatency.data + n,
+                                           [](int32_t late){ return late < 0; });
+  startLatency.report("RunAfter lateness");
+  Serial.printf("%-34s %u of %u\n", "RunAfter fired early", (unsigned)early, (unsigned)n);
+  heap.report("RunAfter heap", jobs);
+}
+
+void benchCallbackQueue(){
+  CallbackQueue& queue = CallbackQueue::instance();
+  callbackLatency.reset();
+  completed = 0;
+  HeapMark heap;
+  uint32_t began = micros();
+  for(uint32_t i=0;i<BENCH_ITERATIONS;i++){
+    uint32_t queued = micros();
+    queue.enqueue([queued](){
+      callbackLatency.add(micros() - queued);
+      completed++;
+    });
+    if(queue.size() >= BENCH_WINDOW) queue.process();
+  }
+  queue.process();
+  uint32_t elapsed = micros() - began;
+  callbackLatency.report("CallbackQueue enqueue->run");
+  heap.report("CallbackQueue heap", BENCH_ITERATIONS);
+  Serial.printf("%-34s %.0f ops/s\n", "CallbackQueue throughput", BENCH_ITERATIONS * 1e6 / elapsed);
+}
+
+struct Producer{
+  uint32_t jobs;
+  bool useQueue;
+  std::atomic<uint32_t>* finished;
+};
+
+void producerLoop(void* param){
+  Producer* p = static_cast<Producer*>(param);
+  std::atomic<uint32_t> done{0};
+  for(uint32_t i=0;i<p->jobs;i++){
+    if(p->useQueue){
+      CallbackQueue::instance().enqueue([](){ completed++; });
+    }else{
+      while(i - done.load() >= BENCH_WINDOW) taskYIELD();
+      std::atomic<uint32_t>* counter = &done;
+      Async::RunFireAndForget([counter](){
+        counter->fetch_add(1);
+        completed++;
+      });
+    }
+  }
+  while(!p->useQueue && done.load() < p->jobs) taskYIELD();
+  p->finished->fetch_add(1);
+  vTaskDelete(NULL);
+}
+
+void benchProducers(bool useQueue){
+  for(int producers=1;producers<=BENCH_MAX_PRODUCERS;producers*=2){
+    const uint32_t perProducer = BENCH_ITERATIONS / producers;
+    std::atomic<uint32_t> finished{0};
+    Producer p = {perProducer, useQueue, &finished};
+    completed = 0;
+    uint32_t began = micros();
+    for(int i=0;i<producers;i++){
+      xTaskCreatePinnedToCore(producerLoop, "BenchProducer", 4096, &p, 2, nullptr, i % 2);
+    }
+    while(finished.load() < (uint32_t)producers || completed.load() < perProducer * producers){
+      Async::update();
+      taskYIELD();
+    }
+    uint32_t elapsed = micros() - began;
+    Serial.printf("%-26s x%-7d %.0f jobs/s\n", useQueue ? "CallbackQueue producers" : "RunFireAndForget producers",
+                  producers, perProducer * producers * 1e6 / elapsed);
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+
+  AsyncConfig config;
+  config.executeCallbacksInLoop = true;
+  config.pendingOverflow = PendingPolicy::Block;
+  Async::setConfig(config);
+
+  Serial.printf("EasyAsync bench: %d iterations, window %d\n", BENCH_ITERATIONS, BENCH_WINDOW);
+  benchRun("pool", false);
+  benchRun("dedicated", true);
+  benchFireAndForget();
+  benchRunAfter(10);
+  benchCallbackQueue();
+  benchProducers(false);
+  benchProducers(true);
+  Serial.println("done");
+}
+
+void loop() {
+  delay(1000);
+}
+
+#ifndef ARDUINO
+int main() {
+  setup();
+  return 0;
+}
+#endif
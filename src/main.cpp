@@ -9,6 +9,7 @@ Task updateTask;
 
 void Draw();
 void Update();
+void Start();
 
 void setup() {
   Serial.begin(115200);
@@ -29,14 +30,17 @@ void setup() {
   config.executeCallbacksInLoop = false;
   Async::setConfig(config);
 
+  Start();
+
   TaskConfig updateCfg;
   updateCfg.name = "UpdateTask";
   updateCfg.core = 1;
-  updateTask = Async::Run([](){Update();},NOCALLBACK, updateCfg);
+  updateTask = Async::RunEvery(10, [](){Update();}, updateCfg);
 
   TaskConfig drawCfg;
   drawCfg.name = "DrawTask";
   drawCfg.core = 0;
+  drawCfg.dedicated = true;
   drawTask = Async::Run([](){Draw();},NOCALLBACK, drawCfg);
 
 }
@@ -57,6 +61,22 @@ typedef struct Obstacle{
 const int MAX_OBSTACLES = 4;
 Obstacle obstacles[MAX_OBSTACLES];
 
+typedef struct GameState{
+  Player player;
+  Obstacle obstacles[MAX_OBSTACLES];
+}GameState;
+
+SharedState<GameState> gameState;
+
+void Publish(){
+  GameState state;
+  state.player = player;
+  for(int i=0;i<MAX_OBSTACLES;i++){
+    state.obstacles[i] = obstacles[i];
+  }
+  gameState.publish(state);
+}
+
 void Start(){
   player.y = 32;
   player.yVel = 0;
@@ -65,40 +85,38 @@ void Start(){
     obstacles[i].y = random(10, 30);
     obstacles[i].gap = random(30, 40);
   }
+  Publish();
 }
 int value = 0;
 
 void Update(){
-  Start();
-  while(true){
-    player.yVel += 0.15;
-    player.y += player.yVel;
-    if(player.y < 0){
-      player.y = 0;
-      player.yVel = 0;
-    }
-    if(player.y > 54){
-      player.y = 54;
-      player.yVel = 0;
-    }
-    if(Serial.available()){
-      char c = Serial.read();
-      if(c == ' '){
-        player.yVel = -1.1;
-      }
+  player.yVel += 0.15;
+  player.y += player.yVel;
+  if(player.y < 0){
+    player.y = 0;
+    player.yVel = 0;
+  }
+  if(player.y > 54){
+    player.y = 54;
+    player.yVel = 0;
+  }
+  if(Serial.available()){
+    char c = Serial.read();
+    if(c == ' '){
+      player.yVel = -1.1;
     }
+  }
 
-    for(int i=0;i<MAX_OBSTACLES;i++){
-      obstacles[i].x -= 1.0;
-      if(obstacles[i].x < -10){
-        obstacles[i].x += 128;
-        obstacles[i].y = random(10, 30);
-        obstacles[i].gap = random(30, 40);
-        value++;
-      }
+  for(int i=0;i<MAX_OBSTACLES;i++){
+    obstacles[i].x -= 1.0;
+    if(obstacles[i].x < -10){
+      obstacles[i].x += 128;
+      obstacles[i].y = random(10, 30);
+      obstacles[i].gap = random(30, 40);
+      value++;
     }
-    delay(10);
   }
+  Publish();
 }
 
 U8G2_SSD1309_128X64_NONAME2_F_HW_I2C u8g2(U8G2_R0);
@@ -107,12 +125,14 @@ void Draw(){
   u8g2.setBusClock(300000); 
   
   while(true){
+    GameState state = gameState.load();
     u8g2.clearBuffer();
 
-    u8g2.drawCircle(20, (int)player.y, 4);
+    u8g2.drawCircle(20, (int)state.player.y, 4);
     for(int i=0;i<MAX_OBSTACLES;i++){
-      u8g2.drawFrame((int)obstacles[i].x, 0, 10, obstacles[i].y);
-      u8g2.drawFrame((int)obstacles[i].x, obstacles[i].y + obstacles[i].gap, 10, 64 - (obstacles[i].y + obstacles[i].gap));
+      const Obstacle& o = state.obstacles[i];
+      u8g2.drawFrame((int)o.x, 0, 10, o.y);
+      u8g2.drawFrame((int)o.x, o.y + o.gap, 10, 64 - (o.y + o.gap));
     }
     u8g2.sendBuffer();
     delay(1);
@@ -0,0 +1,52 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+
+// Host build of the demo: same library, no display. Runs the scheduler for a
+// few seconds and prints what each entry point did.
+
+Task tickTask;
+
+std::atomic<int> ticks{0};
+std::atomic<int> jobs{0};
+unsigned long startedAt = 0;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("OK!");
+
+  AsyncConfig config;
+  config.defaultStackSize = 8192;
+  config.defaultPriority = 2;
+  config.executeCallbacksInLoop = true;
+  Async::setConfig(config);
+
+  TaskConfig tickCfg;
+  tickCfg.name = "TickTask";
+  tickCfg.core = 1;
+  tickTask = Async::RunEvery(10, [](){ticks++;}, tickCfg);
+
+  for(int i=0;i<16;i++){
+    Async::Run([](){return 1;}, [](int v){jobs += v;});
+  }
+
+  Async::RunAfter(500, [](){}, [](){
+    Serial.printf("RunAfter fired at %lu ms\n", millis() - startedAt);
+  });
+
+  startedAt = millis();
+}
+
+void loop() {
+  Async::update();
+  delay(5);
+}
+
+int main() {
+  setup();
+  while(millis() - startedAt < 2000){
+    loop();
+  }
+  tickTask.cancel();
+  Serial.printf("ticks: %d (expected ~200), jobs: %d/16\n", ticks.load(), jobs.load());
+  return 0;
+}
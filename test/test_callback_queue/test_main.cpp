@@ -0,0 +1,326 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// CallbackQueue overflow policies, priority order and aging, per-class
+// counters, budgeted updates,
+// waiting for work and the dispatcher task. The queue is a singleton, so each test switches the
+// policy through Async::setConfig() and tearDown() leaves it empty, with no
+// dispatcher, for the next one.
+
+static AsyncConfig config;
+static int order[32];
+static std::atomic<int> ran{0};
+static std::atomic<bool> producerDone{false};
+
+static CallbackFunction record(int id) {
+  return [id]() { order[ran++] = id; };
+}
+
+static void usePolicy(OverflowPolicy policy, bool inLoop = true) {
+  config.callbackOverflow = policy;
+  config.executeCallbacksInLoop = inLoop;
+  Async::setConfig(config);
+}
+
+static bool waitUntil(bool (*done)(), uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+static int enqueueRange(int first, int count, CallbackPriority priority = CallbackPriority::Normal) {
+  int accepted = 0;
+  for (int i = first; i < first + count; i++) {
+    if (CallbackQueue::instance().enqueue(record(i), priority)) {
+      accepted++;
+    }
+  }
+  return accepted;
+}
+
+void setUp(void) {
+  ran = 0;
+}
+
+void tearDown(void) {
+  config.callbackDispatcher = false;
+  config.callbackAgingMs = 0;
+  Async::setConfig(config);
+  CallbackQueue::instance().process();
+}
+
+void test_drop_newest_keeps_the_first_callbacks(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  uint32_t dropped = Async::droppedCallbacks();
+  TEST_ASSERT_EQUAL(4, enqueueRange(0, 6));
+  TEST_ASSERT_EQUAL(2, Async::droppedCallbacks() - dropped);
+  Async::update();
+  int expected[] = {0, 1, 2, 3};
+  TEST_ASSERT_EQUAL(4, ran.load());
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 4);
+}
+
+void test_drop_oldest_keeps_the_latest_callbacks(void) {
+  usePolicy(OverflowPolicy::DropOldest);
+  uint32_t dropped = Async::droppedCallbacks();
+  TEST_ASSERT_EQUAL(6, enqueueRange(0, 6));
+  TEST_ASSERT_EQUAL(2, Async::droppedCallbacks() - dropped);
+  Async::update();
+  int expected[] = {2, 3, 4, 5};
+  TEST_ASSERT_EQUAL(4, ran.load());
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 4);
+}
+
+void test_run_inline_runs_the_overflow_at_once(void) {
+  usePolicy(OverflowPolicy::RunInline);
+  TEST_ASSERT_EQUAL(6, enqueueRange(0, 6));
+  TEST_ASSERT_EQUAL(2, ran.load());
+  TEST_ASSERT_EQUAL(4, order[0]);
+  TEST_ASSERT_EQUAL(5, order[1]);
+  Async::update();
+  TEST_ASSERT_EQUAL(6, ran.load());
+}
+
+void test_block_runs_inline_when_the_consumer_enqueues(void) {
+  usePolicy(OverflowPolicy::Block);
+  uint32_t dropped = Async::droppedCallbacks();
+  CallbackQueue::instance().enqueue([]() { enqueueRange(0, 8); });
+  Async::update();
+  TEST_ASSERT_EQUAL(8, ran.load());
+  TEST_ASSERT_EQUAL(0, Async::droppedCallbacks() - dropped);
+}
+
+void test_block_drops_when_nothing_drains_the_queue(void) {
+  usePolicy(OverflowPolicy::Block, false);
+  uint32_t dropped = Async::droppedCallbacks();
+  TEST_ASSERT_EQUAL(4, enqueueRange(0, 6));
+  TEST_ASSERT_EQUAL(2, Async::droppedCallbacks() - dropped);
+}
+
+static void producer(void*) {
+  enqueueRange(0, 12);
+  producerDone = true;
+  vTaskDelete(nullptr);
+}
+
+void test_block_waits_for_the_consumer(void) {
+  usePolicy(OverflowPolicy::Block);
+  uint32_t dropped = Async::droppedCallbacks();
+  uint32_t overflowed = CallbackQueue::instance().overflowCount();
+  producerDone = false;
+  TEST_ASSERT_TRUE(xTaskCreate(producer, "producer", 4096, nullptr, 1, nullptr) == pdPASS);
+  delay(20);
+  uint32_t start = millis();
+  while ((!producerDone || Async::pendingCallbacks() > 0) && millis() - start < 1000) {
+    Async::update();
+    delay(1);
+  }
+  TEST_ASSERT_TRUE(producerDone.load());
+  TEST_ASSERT_EQUAL(12, ran.load());
+  for (int i = 0; i < 12; i++) {
+    TEST_ASSERT_EQUAL(i, order[i]);
+  }
+  TEST_ASSERT_GREATER_THAN(0, CallbackQueue::instance().overflowCount() - overflowed);
+  TEST_ASSERT_EQUAL(0, Async::droppedCallbacks() - dropped);
+}
+
+void test_higher_priority_runs_first(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  enqueueRange(0, 2, CallbackPriority::Low);
+  enqueueRange(10, 2, CallbackPriority::Normal);
+  enqueueRange(20, 2, CallbackPriority::High);
+  Async::update();
+  int expected[] = {20, 21, 10, 11, 0, 1};
+  TEST_ASSERT_EQUAL(6, ran.load());
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 6);
+}
+
+void test_aged_low_priority_goes_first(void) {
+  config.callbackAgingMs = 5;
+  usePolicy(OverflowPolicy::DropNewest);
+  uint32_t aged = Async::callbackStats(CallbackPriority::Low).aged;
+  enqueueRange(0, 1, CallbackPriority::Low);
+  delay(10);
+  enqueueRange(20, 2, CallbackPriority::High);
+  Async::update();
+  int expected[] = {0, 20, 21};
+  TEST_ASSERT_EQUAL(3, ran.load());
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 3);
+  TEST_ASSERT_EQUAL(1, Async::callbackStats(CallbackPriority::Low).aged - aged);
+}
+
+void test_class_stats_count_depth_and_wait(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  CallbackClassStats before = Async::callbackStats(CallbackPriority::Normal);
+  enqueueRange(0, 3);
+  CallbackClassStats queued = Async::callbackStats(CallbackPriority::Normal);
+  TEST_ASSERT_EQUAL(3, queued.depth);
+  TEST_ASSERT_GREATER_OR_EQUAL(3, queued.peakDepth);
+  delay(5);
+  Async::update();
+  CallbackClassStats after = Async::callbackStats(CallbackPriority::Normal);
+  TEST_ASSERT_EQUAL(0, after.depth);
+  TEST_ASSERT_EQUAL(3, after.processed - before.processed);
+  TEST_ASSERT_GREATER_OR_EQUAL(5000, after.maxWaitUs);
+  TEST_ASSERT_GREATER_THAN(0, after.averageWaitUs);
+}
+
+void test_task_config_picks_the_callback_class(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  TaskConfig low;
+  low.callbackPriority = CallbackPriority::Low;
+  TaskConfig high;
+  high.callbackPriority = CallbackPriority::High;
+  Task first = Async::Run([]() {}, []() { order[ran++] = 1; }, low);
+  Task second = Async::Run([]() {}, []() { order[ran++] = 2; }, high);
+  TEST_ASSERT_TRUE(waitUntil([]() { return Async::pendingCallbacks() == 2; }, 500));
+  Async::update();
+  int expected[] = {2, 1};
+  TEST_ASSERT_EQUAL(2, ran.load());
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 2);
+}
+
+static CallbackFunction slow(int id, uint32_t us) {
+  return [id, us]() {
+    delayMicroseconds(us);
+    order[ran++] = id;
+  };
+}
+
+void test_update_stops_after_max_callbacks(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  enqueueRange(0, 4);
+  TEST_ASSERT_EQUAL(2, Async::update(0, 2));
+  TEST_ASSERT_EQUAL(2, ran.load());
+  const UpdateStats& stats = Async::lastUpdateStats();
+  TEST_ASSERT_EQUAL(2, stats.processed);
+  TEST_ASSERT_EQUAL(2, stats.remaining);
+  TEST_ASSERT_EQUAL(0, Async::update(0, 2));
+  int expected[] = {0, 1, 2, 3};
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, order, 4);
+}
+
+void test_update_stops_when_the_time_budget_runs_out(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  for (int i = 0; i < 4; i++) {
+    CallbackQueue::instance().enqueue(slow(i, 2000));
+  }
+  size_t remaining = Async::update(3000);
+  TEST_ASSERT_GREATER_OR_EQUAL(1, ran.load());
+  TEST_ASSERT_LESS_OR_EQUAL(2, ran.load());
+  TEST_ASSERT_EQUAL(4 - ran.load(), remaining);
+  const UpdateStats& stats = Async::lastUpdateStats();
+  TEST_ASSERT_EQUAL(ran.load(), stats.processed);
+  TEST_ASSERT_GREATER_OR_EQUAL(2000, stats.drainUs);
+  TEST_ASSERT_GREATER_OR_EQUAL(stats.drainUs, stats.maxDrainUs);
+}
+
+void test_tiny_budget_still_runs_one_callback(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  CallbackQueue::instance().enqueue(slow(0, 500));
+  CallbackQueue::instance().enqueue(slow(1, 500));
+  TEST_ASSERT_EQUAL(1, Async::update(1));
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_EQUAL(0, order[0]);
+}
+
+static void lateProducer(void*) {
+  delay(20);
+  enqueueRange(0, 1);
+  vTaskDelete(nullptr);
+}
+
+void test_wait_for_callbacks_wakes_on_enqueue(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  TEST_ASSERT_TRUE(xTaskCreate(lateProducer, "producer", 4096, nullptr, 1, nullptr) == pdPASS);
+  uint32_t start = millis();
+  TEST_ASSERT_TRUE(Async::waitForCallbacks(1000));
+  TEST_ASSERT_LESS_OR_EQUAL(500, millis() - start);
+  Async::update();
+  TEST_ASSERT_EQUAL(1, ran.load());
+}
+
+void test_waiting_leaves_the_task_notification_alone(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+  TEST_ASSERT_FALSE(Async::waitForCallbacks(20));
+  TEST_ASSERT_EQUAL(1, ulTaskNotifyTake(pdTRUE, 0));
+}
+
+static TaskHandle_t ranOn = nullptr;
+
+void test_dispatcher_stops_and_restarts(void) {
+  usePolicy(OverflowPolicy::DropNewest);
+  config.callbackDispatcher = true;
+  Async::setConfig(config);
+  TEST_ASSERT_TRUE(CallbackQueue::instance().dispatching());
+  enqueueRange(0, 1);
+  TEST_ASSERT_TRUE(waitUntil([]() { return ran.load() == 1; }, 500));
+
+  config.callbackDispatcher = false;
+  Async::setConfig(config);
+  TEST_ASSERT_FALSE(CallbackQueue::instance().dispatching());
+  enqueueRange(1, 1);
+  delay(20);
+  TEST_ASSERT_EQUAL(1, ran.load());
+  Async::update();
+  TEST_ASSERT_EQUAL(2, ran.load());
+
+  config.callbackDispatcher = true;
+  Async::setConfig(config);
+  config.dispatcherPriority++;
+  Async::setConfig(config);
+  TEST_ASSERT_TRUE(CallbackQueue::instance().dispatching());
+  CallbackQueue::instance().enqueue([]() {
+    ranOn = xTaskGetCurrentTaskHandle();
+    ran++;
+  });
+  TEST_ASSERT_TRUE(waitUntil([]() { return ran.load() == 3; }, 500));
+  TEST_ASSERT_TRUE(ranOn != xTaskGetCurrentTaskHandle());
+  TEST_ASSERT_EQUAL(config.dispatcherPriority, uxTaskPriorityGet(ranOn));
+}
+
+static int runTests() {
+  // Four slots per priority class, and no aging so order is strict.
+  config.callbackQueueSize = 4;
+  config.callbackAgingMs = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_drop_newest_keeps_the_first_callbacks);
+  RUN_TEST(test_drop_oldest_keeps_the_latest_callbacks);
+  RUN_TEST(test_run_inline_runs_the_overflow_at_once);
+  RUN_TEST(test_block_runs_inline_when_the_consumer_enqueues);
+  RUN_TEST(test_block_drops_when_nothing_drains_the_queue);
+  RUN_TEST(test_block_waits_for_the_consumer);
+  RUN_TEST(test_higher_priority_runs_first);
+  RUN_TEST(test_aged_low_priority_goes_first);
+  RUN_TEST(test_class_stats_count_depth_and_wait);
+  RUN_TEST(test_task_config_picks_the_callback_class);
+  RUN_TEST(test_update_stops_after_max_callbacks);
+  RUN_TEST(test_update_stops_when_the_time_budget_runs_out);
+  RUN_TEST(test_tiny_budget_still_runs_one_callback);
+  RUN_TEST(test_wait_for_callbacks_wakes_on_enqueue);
+  RUN_TEST(test_waiting_leaves_the_task_notification_alone);
+  RUN_TEST(test_dispatcher_stops_and_restarts);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
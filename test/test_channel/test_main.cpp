@@ -0,0 +1,203 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// Channel send/receive in both modes, full/empty edges, timeouts, batches
+// and the onAvailable() hook, including channels destroyed around it.
+
+static const uint32_t PerProducer = 2000;
+static const int Producers = 4;
+static const int Consumers = 2;
+
+static TaskConfig dedicated() {
+  TaskConfig taskConfig;
+  taskConfig.dedicated = true;
+  return taskConfig;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_spsc_keeps_fifo_order(void) {
+  static Channel<uint32_t, 8, ChannelMode::SPSC> channel;
+  Future<void> producer = Async::Run([]() {
+    for (uint32_t i = 0; i < PerProducer; i++) {
+      channel.send(i);
+    }
+  }, dedicated());
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < PerProducer; i++) {
+    TEST_ASSERT_TRUE(channel.receive(value, 1000));
+    TEST_ASSERT_EQUAL(i, value);
+  }
+  TEST_ASSERT_TRUE(producer.wait(1000));
+  TEST_ASSERT_TRUE(channel.empty());
+}
+
+void test_mpmc_delivers_every_item_once(void) {
+  static Channel<uint32_t, 16, ChannelMode::MPMC> channel;
+  static std::atomic<uint32_t> received{0};
+  static std::atomic<uint64_t> sum{0};
+  received = 0;
+  sum = 0;
+
+  Future<void> producers[Producers];
+  for (int p = 0; p < Producers; p++) {
+    producers[p] = Async::Run([p]() {
+      for (uint32_t i = 0; i < PerProducer; i++) {
+        channel.send(p * PerProducer + i);
+      }
+    }, dedicated());
+  }
+  Future<void> consumers[Consumers];
+  for (Future<void>& consumer : consumers) {
+    consumer = Async::Run([]() {
+      uint32_t value = 0;
+      while (channel.receive(value, 200)) {
+        received++;
+        sum += value;
+      }
+    }, dedicated());
+  }
+  for (Future<void>& producer : producers) {
+    TEST_ASSERT_TRUE(producer.wait(2000));
+  }
+  for (Future<void>& consumer : consumers) {
+    TEST_ASSERT_TRUE(consumer.wait(2000));
+  }
+
+  uint64_t total = (uint64_t)Producers * PerProducer;
+  TEST_ASSERT_EQUAL(total, received.load());
+  TEST_ASSERT_EQUAL(total * (total - 1) / 2, sum.load());
+}
+
+void test_try_send_and_receive_stop_at_the_edges(void) {
+  Channel<int, 4> channel;
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(channel.trySend(i));
+  }
+  TEST_ASSERT_FALSE(channel.trySend(4));
+  TEST_ASSERT_EQUAL(4, channel.size());
+  int value = -1;
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(channel.tryReceive(value));
+    TEST_ASSERT_EQUAL(i, value);
+  }
+  TEST_ASSERT_FALSE(channel.tryReceive(value));
+}
+
+void test_send_and_receive_time_out(void) {
+  Channel<int, 2> channel;
+  int value = 0;
+  uint32_t start = millis();
+  TEST_ASSERT_FALSE(channel.receive(value, 30));
+  uint32_t waited = millis() - start;
+  TEST_ASSERT_GREATER_OR_EQUAL(29, waited);
+  TEST_ASSERT_LESS_OR_EQUAL(200, waited);
+
+  channel.trySend(1);
+  channel.trySend(2);
+  start = millis();
+  TEST_ASSERT_FALSE(channel.send(3, 30));
+  waited = millis() - start;
+  TEST_ASSERT_GREATER_OR_EQUAL(29, waited);
+  TEST_ASSERT_LESS_OR_EQUAL(200, waited);
+}
+
+void test_batches_send_what_fits(void) {
+  Channel<int, 8> channel;
+  int items[10];
+  for (int i = 0; i < 10; i++) {
+    items[i] = i;
+  }
+  TEST_ASSERT_EQUAL(8, channel.sendN(items, 10, 0));
+  TEST_ASSERT_EQUAL(8, items[8]);
+  TEST_ASSERT_EQUAL(9, items[9]);
+
+  int out[16];
+  TEST_ASSERT_EQUAL(8, channel.receiveN(out, 16, 0));
+  for (int i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(i, out[i]);
+  }
+  TEST_ASSERT_EQUAL(0, channel.receiveN(out, 16, 0));
+}
+
+void test_on_available_runs_from_update(void) {
+  static Channel<int, 4> channel;
+  static std::atomic<int> drained{0};
+  channel.onAvailable([]() {
+    int value = 0;
+    while (channel.tryReceive(value)) {
+      drained++;
+    }
+  });
+  channel.trySend(1);
+  channel.trySend(2);
+  TEST_ASSERT_EQUAL(0, drained.load());
+  Async::update();
+  TEST_ASSERT_EQUAL(2, drained.load());
+  channel.trySend(3);
+  Async::update();
+  TEST_ASSERT_EQUAL(3, drained.load());
+}
+
+void test_notify_queued_past_the_channel_does_nothing(void) {
+  static std::atomic<int> notified{0};
+  notified = 0;
+  Channel<int, 4>* channel = new Channel<int, 4>();
+  channel->onAvailable([]() { notified++; });
+  channel->trySend(1);
+  delete channel;
+  Async::update();
+  TEST_ASSERT_EQUAL(0, notified.load());
+}
+
+void test_notifier_may_destroy_its_channel(void) {
+  static Channel<int, 4>* channel = nullptr;
+  static std::atomic<int> drained{0};
+  drained = 0;
+  channel = new Channel<int, 4>();
+  channel->onAvailable([]() {
+    int value = 0;
+    while (channel->tryReceive(value)) {
+      drained++;
+    }
+    delete channel;
+    channel = nullptr;
+  });
+  channel->trySend(1);
+  Async::update();
+  TEST_ASSERT_EQUAL(1, drained.load());
+  TEST_ASSERT_TRUE(channel == nullptr);
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_spsc_keeps_fifo_order);
+  RUN_TEST(test_mpmc_delivers_every_item_once);
+  RUN_TEST(test_try_send_and_receive_stop_at_the_edges);
+  RUN_TEST(test_send_and_receive_time_out);
+  RUN_TEST(test_batches_send_what_fits);
+  RUN_TEST(test_on_available_runs_from_update);
+  RUN_TEST(test_notify_queued_past_the_channel_does_nothing);
+  RUN_TEST(test_notifier_may_destroy_its_channel);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
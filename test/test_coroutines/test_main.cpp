@@ -0,0 +1,153 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// Coroutine support (C++20 only): AsyncTask results, awaiting futures
+// (move-only and failed ones too), hopping between the loop and the
+// workers, and delays that outnumber the timer pool.
+
+static TaskHandle_t loopTask = nullptr;
+static std::atomic<int> woke{0};
+
+static bool waitUntilReady(const Future<bool>& future, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!future.wait(0)) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    Async::update();
+    delay(1);
+  }
+  return true;
+}
+
+static AsyncTask<int> addLater(int a, int b) {
+  co_await Async::Delay(10);
+  co_return a + b;
+}
+
+static AsyncTask<int> addOneTo(Future<int> input) {
+  int value = co_await input;
+  co_return value + 1;
+}
+
+static AsyncTask<int> unwrap(Future<std::unique_ptr<int>> input) {
+  std::unique_ptr<int> value = co_await input;
+  co_return *value;
+}
+
+static AsyncTask<bool> catchFailure(Future<int> input) {
+  try {
+    co_await input;
+  } catch (const FutureError&) {
+    co_return true;
+  }
+  co_return false;
+}
+
+static AsyncTask<int> passFailureOn(Future<int> input) {
+  int value = co_await input;
+  co_return value + 1;
+}
+
+static AsyncTask<bool> hopToLoopAndBack() {
+  co_await Async::SwitchToLoop();
+  bool onLoop = xTaskGetCurrentTaskHandle() == loopTask;
+  co_await Async::SwitchToWorker();
+  co_return onLoop && xTaskGetCurrentTaskHandle() != loopTask;
+}
+
+static AsyncTask<void> sleepFor(uint32_t ms) {
+  uint32_t start = millis();
+  co_await Async::Delay(ms);
+  if (millis() - start >= ms) {
+    woke++;
+  }
+}
+
+void setUp(void) {
+  woke = 0;
+}
+
+void tearDown(void) {}
+
+void test_async_task_returns_its_value(void) {
+  AsyncTask<int> task = addLater(2, 3);
+  TEST_ASSERT_TRUE(task.wait(500));
+  TEST_ASSERT_EQUAL(5, task.get());
+}
+
+void test_co_await_takes_a_future_result(void) {
+  AsyncTask<int> task = addOneTo(Async::Run([]() { return 20; }));
+  TEST_ASSERT_TRUE(task.wait(500));
+  TEST_ASSERT_EQUAL(21, task.get());
+}
+
+void test_co_await_moves_a_move_only_result(void) {
+  AsyncTask<int> task = unwrap(Async::Run([]() { return std::unique_ptr<int>(new int(9)); }));
+  TEST_ASSERT_TRUE(task.wait(500));
+  TEST_ASSERT_EQUAL(9, task.get());
+}
+
+void test_co_await_of_a_failed_future_throws(void) {
+  AsyncTask<bool> caught = catchFailure(Async::Run([]() -> int { throw 1; }));
+  TEST_ASSERT_TRUE(caught.wait(500));
+  TEST_ASSERT_TRUE(caught.get());
+
+  AsyncTask<int> passed = passFailureOn(Async::Run([]() -> int { throw 1; }));
+  TEST_ASSERT_TRUE(passed.wait(500));
+  TEST_ASSERT_TRUE(passed.failed());
+}
+
+void test_switching_between_loop_and_workers(void) {
+  AsyncTask<bool> task = hopToLoopAndBack();
+  TEST_ASSERT_TRUE(waitUntilReady(task, 500));
+  TEST_ASSERT_TRUE(task.get());
+}
+
+void test_delays_beyond_the_timer_pool_leave_workers_free(void) {
+  const int count = 12;
+  AsyncTask<void> sleepers[count];
+  for (AsyncTask<void>& sleeper : sleepers) {
+    sleeper = sleepFor(300);
+  }
+  delay(20);
+  // Every worker would be stuck in a sleeper's delay if overflowing delays
+  // blocked the thread they ran on.
+  Future<int> quick = Async::Run([]() { return 1; });
+  TEST_ASSERT_TRUE(quick.wait(150));
+  for (AsyncTask<void>& sleeper : sleepers) {
+    TEST_ASSERT_TRUE(sleeper.wait(2000));
+  }
+  TEST_ASSERT_EQUAL(count, woke.load());
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  config.maxTimers = 4;
+  Async::setConfig(config);
+  loopTask = xTaskGetCurrentTaskHandle();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_async_task_returns_its_value);
+  RUN_TEST(test_co_await_takes_a_future_result);
+  RUN_TEST(test_co_await_moves_a_move_only_result);
+  RUN_TEST(test_co_await_of_a_failed_future_throws);
+  RUN_TEST(test_switching_between_loop_and_workers);
+  RUN_TEST(test_delays_beyond_the_timer_pool_leave_workers_free);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
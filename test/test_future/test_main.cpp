@@ -0,0 +1,205 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// Future results: move-only values, failures that get() reports, then()
+// chains, and the WhenAll/WhenAny combinators.
+
+static std::atomic<bool> release{false};
+
+static bool throwsFutureError(void (*body)()) {
+  try {
+    body();
+  } catch (const FutureError&) {
+    return true;
+  }
+  return false;
+}
+
+static void waitForRelease() {
+  while (!release) {
+    delay(1);
+  }
+}
+
+void setUp(void) {
+  release = false;
+}
+
+void tearDown(void) {
+  release = true;
+}
+
+void test_move_only_result_can_be_taken(void) {
+  Future<std::unique_ptr<int>> future = Async::Run([]() {
+    return std::unique_ptr<int>(new int(42));
+  });
+  std::unique_ptr<int> value = std::move(future.get());
+  TEST_ASSERT_TRUE(value != nullptr);
+  TEST_ASSERT_EQUAL(42, *value);
+  TEST_ASSERT_TRUE(future.get() == nullptr);
+}
+
+void test_get_returns_the_same_value_every_time(void) {
+  Future<int> future = Async::Run([]() { return 7; });
+  TEST_ASSERT_EQUAL(7, future.get());
+  TEST_ASSERT_EQUAL(7, future.get());
+}
+
+void test_get_throws_when_the_body_throws(void) {
+  static Future<int> future;
+  future = Async::Run([]() -> int { throw 1; });
+  TEST_ASSERT_TRUE(future.wait(500));
+  TEST_ASSERT_TRUE(future.failed());
+  TEST_ASSERT_TRUE(throwsFutureError([]() { future.get(); }));
+  future = Future<int>();
+}
+
+void test_get_throws_when_cancelled(void) {
+  static Future<void> future;
+  future = Async::Run([]() { delay(50); });
+  future.cancel();
+  TEST_ASSERT_TRUE(throwsFutureError([]() { future.get(); }));
+  future = Future<void>();
+}
+
+void test_get_throws_on_an_empty_future(void) {
+  TEST_ASSERT_TRUE(throwsFutureError([]() { Future<int>().get(); }));
+}
+
+void test_then_passes_the_value_along(void) {
+  Future<int> doubled = Async::Run([]() { return 21; }).then([](int& value) { return value * 2; });
+  TEST_ASSERT_EQUAL(42, doubled.get());
+}
+
+void test_when_all_collects_mixed_results(void) {
+  Future<int> number = Async::Run([]() { return 3; });
+  Future<bool> flag = Async::Run([]() {
+    delay(10);
+    return true;
+  });
+  Future<void> done = Async::Run([]() {});
+  auto all = Async::WhenAll(number, flag, done);
+  TEST_ASSERT_TRUE(all.wait(500));
+  TEST_ASSERT_TRUE(all.ready());
+  TEST_ASSERT_EQUAL(3, std::get<0>(all.get()));
+  TEST_ASSERT_TRUE(std::get<1>(all.get()));
+}
+
+void test_when_all_keeps_array_order(void) {
+  Future<int> futures[8];
+  for (int i = 0; i < 8; i++) {
+    futures[i] = Async::Run([i]() {
+      delay(8 - i);
+      return i * i;
+    });
+  }
+  Future<std::vector<int>> all = Async::WhenAll(futures, 8);
+  TEST_ASSERT_TRUE(all.wait(500));
+  const std::vector<int>& values = all.get();
+  TEST_ASSERT_EQUAL(8, values.size());
+  for (int i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(i * i, values[i]);
+  }
+}
+
+void test_when_all_fails_without_waiting_for_the_rest(void) {
+  Future<int> slow = Async::Run([]() {
+    waitForRelease();
+    return 1;
+  });
+  Future<int> broken = Async::Run([]() -> int { throw 1; });
+  auto all = Async::WhenAll(slow, broken);
+  TEST_ASSERT_TRUE(all.wait(500));
+  TEST_ASSERT_TRUE(all.failed());
+  TEST_ASSERT_FALSE(slow.wait(0));
+  release = true;
+  TEST_ASSERT_TRUE(slow.wait(500));
+}
+
+void test_when_all_signals_once(void) {
+  static std::atomic<int> signalled{0};
+  signalled = 0;
+  Future<int> futures[6];
+  for (int i = 0; i < 6; i++) {
+    futures[i] = Async::Run([i]() { return i; });
+  }
+  Future<void> after = Async::WhenAll(futures, 6).then([](std::vector<int>&) { signalled++; });
+  TEST_ASSERT_TRUE(after.wait(500));
+  delay(10);
+  TEST_ASSERT_EQUAL(1, signalled.load());
+}
+
+void test_when_all_of_nothing_is_ready(void) {
+  Future<std::vector<int>> all = Async::WhenAll((const Future<int>*)nullptr, 0);
+  TEST_ASSERT_TRUE(all.ready());
+  TEST_ASSERT_EQUAL(0, all.get().size());
+}
+
+void test_when_any_reports_the_first_ready_index(void) {
+  Future<int> slow = Async::Run([]() {
+    waitForRelease();
+    return 0;
+  });
+  Future<int> quick = Async::Run([]() { return 1; });
+  Future<size_t> any = Async::WhenAny(slow, quick);
+  TEST_ASSERT_TRUE(any.wait(500));
+  TEST_ASSERT_EQUAL(1, any.get());
+  release = true;
+  TEST_ASSERT_TRUE(slow.wait(500));
+}
+
+void test_when_any_skips_failures_until_all_fail(void) {
+  Future<int> futures[3];
+  futures[0] = Async::Run([]() -> int { throw 1; });
+  futures[1] = Async::Run([]() {
+    delay(20);
+    return 1;
+  });
+  futures[2] = Async::Run([]() -> int { throw 2; });
+  Future<size_t> any = Async::WhenAny(futures, 3);
+  TEST_ASSERT_TRUE(any.wait(500));
+  TEST_ASSERT_EQUAL(1, any.get());
+
+  Future<int> broken[2];
+  broken[0] = Async::Run([]() -> int { throw 1; });
+  broken[1] = Async::Run([]() -> int { throw 2; });
+  Future<size_t> none = Async::WhenAny(broken, 2);
+  TEST_ASSERT_TRUE(none.wait(500));
+  TEST_ASSERT_TRUE(none.failed());
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_move_only_result_can_be_taken);
+  RUN_TEST(test_get_returns_the_same_value_every_time);
+  RUN_TEST(test_get_throws_when_the_body_throws);
+  RUN_TEST(test_get_throws_when_cancelled);
+  RUN_TEST(test_get_throws_on_an_empty_future);
+  RUN_TEST(test_then_passes_the_value_along);
+  RUN_TEST(test_when_all_collects_mixed_results);
+  RUN_TEST(test_when_all_keeps_array_order);
+  RUN_TEST(test_when_all_fails_without_waiting_for_the_rest);
+  RUN_TEST(test_when_all_signals_once);
+  RUN_TEST(test_when_all_of_nothing_is_ready);
+  RUN_TEST(test_when_any_reports_the_first_ready_index);
+  RUN_TEST(test_when_any_skips_failures_until_all_fail);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
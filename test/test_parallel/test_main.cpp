@@ -0,0 +1,95 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+#include <string>
+
+// ParallelFor, ParallelMap and ParallelReduce: every index is visited once,
+// partials combine in chunk order, and reduce values need no default
+// constructor.
+
+// No default constructor, so ParallelReduce has to seed its partials.
+struct Sum {
+  explicit Sum(uint32_t v) : value(v) {}
+  uint32_t value;
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_parallel_for_visits_every_index_once(void) {
+  static std::atomic<uint8_t> seen[1000];
+  for (std::atomic<uint8_t>& s : seen) {
+    s = 0;
+  }
+  TEST_ASSERT_TRUE(Async::ParallelFor(0, 1000, 0, [](size_t i) { seen[i]++; }));
+  for (std::atomic<uint8_t>& s : seen) {
+    TEST_ASSERT_EQUAL(1, s.load());
+  }
+}
+
+void test_parallel_map_fills_the_output(void) {
+  int input[64];
+  int output[64];
+  for (int i = 0; i < 64; i++) {
+    input[i] = i;
+  }
+  TEST_ASSERT_TRUE(Async::ParallelMap(input, output, 64, 4, [](int v) { return v * v; }));
+  for (int i = 0; i < 64; i++) {
+    TEST_ASSERT_EQUAL(i * i, output[i]);
+  }
+}
+
+void test_reduce_works_without_a_default_constructor(void) {
+  Sum total = Async::ParallelReduce(0, 1000, 0, Sum(0),
+      [](size_t i) { return Sum((uint32_t)i); },
+      [](const Sum& a, const Sum& b) { return Sum(a.value + b.value); });
+  TEST_ASSERT_EQUAL(999 * 1000 / 2, total.value);
+}
+
+void test_reduce_combines_in_chunk_order(void) {
+  std::string joined = Async::ParallelReduce(0, 26, 3, std::string(),
+      [](size_t i) { return std::string(1, (char)('a' + i)); },
+      [](const std::string& a, const std::string& b) { return a + b; });
+  TEST_ASSERT_TRUE(joined == "abcdefghijklmnopqrstuvwxyz");
+}
+
+void test_reduce_returns_identity_when_a_chunk_throws(void) {
+  int total = Async::ParallelReduce(0, 100, 10, -1,
+      [](size_t i) -> int {
+        if (i == 55) {
+          throw 1;
+        }
+        return 1;
+      },
+      [](int a, int b) { return a + b; });
+  TEST_ASSERT_EQUAL(-1, total);
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_parallel_for_visits_every_index_once);
+  RUN_TEST(test_parallel_map_fills_the_output);
+  RUN_TEST(test_reduce_works_without_a_default_constructor);
+  RUN_TEST(test_reduce_combines_in_chunk_order);
+  RUN_TEST(test_reduce_returns_identity_when_a_chunk_throws);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
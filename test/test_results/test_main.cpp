@@ -0,0 +1,213 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+#include <cstdlib>
+
+// Task result callbacks: values reach the callback intact and are moved, not
+// copied, and a result that fits the callback record costs no allocation.
+
+static std::atomic<bool> counting{false};
+static std::atomic<int> allocations{0};
+static std::atomic<int> ran{0};
+
+// Not inlined, so the compiler never pairs a new-expression with the free()
+// inside and warns about a mismatch.
+__attribute__((noinline)) void* operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void* p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// Counts copies and live instances, so a test can tell how a result was
+// handed over and that it was destroyed.
+struct Counted {
+  static std::atomic<int> live;
+  static std::atomic<int> copies;
+  explicit Counted(int v) : value(v) { live++; }
+  Counted(const Counted& other) : value(other.value) {
+    live++;
+    copies++;
+  }
+  Counted(Counted&& other) : value(other.value) { live++; }
+  Counted& operator=(const Counted& other) {
+    value = other.value;
+    copies++;
+    return *this;
+  }
+  Counted& operator=(Counted&&) = default;
+  ~Counted() { live--; }
+  int value;
+};
+
+std::atomic<int> Counted::live{0};
+std::atomic<int> Counted::copies{0};
+
+struct Big {
+  uint8_t bytes[4 * ASYNC_CALLBACK_CAPACITY];
+};
+
+static bool waitUntil(bool (*done)(), uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+static bool callbackQueued() {
+  return Async::pendingCallbacks() == 1;
+}
+
+// Allocations made by one task from Run() until its callback has run.
+template<typename Func, typename Callback>
+static int allocationsFor(Func func, Callback callback) {
+  ran = 0;
+  allocations = 0;
+  counting = true;
+  {
+    Task task = Async::Run(func, callback);
+    waitUntil(callbackQueued, 500);
+    Async::update();
+  }
+  counting = false;
+  return allocations.load();
+}
+
+void setUp(void) {
+  ran = 0;
+  Counted::live = 0;
+  Counted::copies = 0;
+}
+
+void tearDown(void) {}
+
+void test_small_result_reaches_the_callback(void) {
+  static int seen = 0;
+  Async::Run([]() { return 42; }, [](int& value) {
+    seen = value;
+    ran++;
+  });
+  TEST_ASSERT_TRUE(waitUntil(callbackQueued, 500));
+  Async::update();
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_EQUAL(42, seen);
+}
+
+void test_large_result_reaches_the_callback(void) {
+  static bool intact = false;
+  Async::Run([]() {
+    Big big;
+    for (size_t i = 0; i < sizeof(big.bytes); i++) {
+      big.bytes[i] = (uint8_t)i;
+    }
+    return big;
+  }, [](Big& big) {
+    intact = true;
+    for (size_t i = 0; i < sizeof(big.bytes); i++) {
+      intact = intact && big.bytes[i] == (uint8_t)i;
+    }
+    ran++;
+  });
+  TEST_ASSERT_TRUE(waitUntil(callbackQueued, 500));
+  Async::update();
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_TRUE(intact);
+}
+
+void test_move_only_result_reaches_the_callback(void) {
+  static int seen = 0;
+  Async::Run([]() { return std::unique_ptr<int>(new int(7)); },
+             [](std::unique_ptr<int>& value) {
+               seen = *value;
+               ran++;
+             });
+  TEST_ASSERT_TRUE(waitUntil(callbackQueued, 500));
+  Async::update();
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_EQUAL(7, seen);
+}
+
+void test_result_is_moved_not_copied(void) {
+  static int seen = 0;
+  {
+    Task task = Async::Run([]() { return Counted(5); }, [](Counted& value) {
+      seen = value.value;
+      ran++;
+    });
+    TEST_ASSERT_TRUE(waitUntil(callbackQueued, 500));
+    Async::update();
+  }
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_EQUAL(5, seen);
+  TEST_ASSERT_EQUAL(0, Counted::copies.load());
+  TEST_ASSERT_EQUAL(0, Counted::live.load());
+}
+
+void test_small_result_costs_no_allocation(void) {
+  int none = allocationsFor([]() {}, []() { ran++; });
+  TEST_ASSERT_EQUAL(1, ran.load());
+  int small = allocationsFor([]() { return 42; }, [](int&) { ran++; });
+  TEST_ASSERT_EQUAL(1, ran.load());
+  int big = allocationsFor([]() { return Big(); }, [](Big&) { ran++; });
+  TEST_ASSERT_EQUAL(1, ran.load());
+  TEST_ASSERT_EQUAL(none, small);
+  TEST_ASSERT_EQUAL(none + 1, big);
+}
+
+void test_callback_runs_on_the_task_outside_the_loop(void) {
+  static int seen = 0;
+  TaskConfig taskConfig;
+  taskConfig.executeInLoop = false;
+  Async::Run([]() { return 9; }, [](int& value) {
+    seen = value;
+    ran++;
+  }, taskConfig);
+  TEST_ASSERT_TRUE(waitUntil([]() { return ran.load() == 1; }, 500));
+  TEST_ASSERT_EQUAL(9, seen);
+  TEST_ASSERT_EQUAL(0, Async::pendingCallbacks());
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_small_result_reaches_the_callback);
+  RUN_TEST(test_large_result_reaches_the_callback);
+  RUN_TEST(test_move_only_result_reaches_the_callback);
+  RUN_TEST(test_result_is_moved_not_copied);
+  RUN_TEST(test_small_result_costs_no_allocation);
+  RUN_TEST(test_callback_runs_on_the_task_outside_the_loop);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
@@ -0,0 +1,146 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// SharedState: readers get the latest published value, versions count
+// publishes, and a reader racing the writer never sees a torn copy.
+
+// Fields derived from one counter, so a torn copy breaks the relations.
+struct Frame {
+  uint32_t seq;
+  uint32_t doubled;
+  uint32_t inverted;
+  uint8_t tail[13];
+};
+
+static Frame frameFor(uint32_t seq) {
+  Frame frame;
+  frame.seq = seq;
+  frame.doubled = seq * 2;
+  frame.inverted = ~seq;
+  for (uint8_t& b : frame.tail) {
+    b = (uint8_t)seq;
+  }
+  return frame;
+}
+
+static bool consistent(const Frame& frame) {
+  if (frame.doubled != frame.seq * 2 || frame.inverted != ~frame.seq) {
+    return false;
+  }
+  for (uint8_t b : frame.tail) {
+    if (b != (uint8_t)frame.seq) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static TaskConfig dedicated() {
+  TaskConfig taskConfig;
+  taskConfig.dedicated = true;
+  return taskConfig;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_load_returns_the_latest_publish(void) {
+  SharedState<Frame> state(frameFor(1));
+  TEST_ASSERT_EQUAL(1, state.load().seq);
+  state.publish(frameFor(2));
+  Frame frame = state.load();
+  TEST_ASSERT_EQUAL(2, frame.seq);
+  TEST_ASSERT_TRUE(consistent(frame));
+}
+
+void test_version_counts_publishes(void) {
+  SharedState<int> state;
+  TEST_ASSERT_EQUAL(0, state.version());
+  TEST_ASSERT_EQUAL(0, state.load());
+  state.publish(5);
+  state.publish(6);
+  TEST_ASSERT_EQUAL(2, state.version());
+}
+
+void test_load_if_changed_only_copies_new_values(void) {
+  SharedState<int> state(1);
+  uint32_t seen = state.version();
+  int value = 0;
+  TEST_ASSERT_FALSE(state.loadIfChanged(value, seen));
+  TEST_ASSERT_EQUAL(0, value);
+  state.publish(7);
+  TEST_ASSERT_TRUE(state.loadIfChanged(value, seen));
+  TEST_ASSERT_EQUAL(7, value);
+  TEST_ASSERT_FALSE(state.loadIfChanged(value, seen));
+}
+
+void test_readers_never_see_a_torn_frame(void) {
+  static SharedState<Frame> state(frameFor(0));
+  static std::atomic<bool> writing{true};
+  static std::atomic<uint32_t> torn{0};
+  static std::atomic<uint32_t> backwards{0};
+  writing = true;
+  torn = 0;
+  backwards = 0;
+
+  Future<void> writer = Async::Run([]() {
+    for (uint32_t seq = 1; seq <= 20000; seq++) {
+      state.publish(frameFor(seq));
+      if (seq % 64 == 0) {
+        delay(1);
+      }
+    }
+    writing = false;
+  }, dedicated());
+  Future<void> readers[2];
+  for (Future<void>& reader : readers) {
+    reader = Async::Run([]() {
+      uint32_t last = 0;
+      while (writing) {
+        Frame frame = state.load();
+        if (!consistent(frame)) {
+          torn++;
+        }
+        if (frame.seq < last) {
+          backwards++;
+        }
+        last = frame.seq;
+      }
+    }, dedicated());
+  }
+  TEST_ASSERT_TRUE(writer.wait(5000));
+  for (Future<void>& reader : readers) {
+    TEST_ASSERT_TRUE(reader.wait(1000));
+  }
+  TEST_ASSERT_EQUAL(0, torn.load());
+  TEST_ASSERT_EQUAL(0, backwards.load());
+  TEST_ASSERT_EQUAL(20000, state.load().seq);
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_load_returns_the_latest_publish);
+  RUN_TEST(test_version_counts_publishes);
+  RUN_TEST(test_load_if_changed_only_copies_new_values);
+  RUN_TEST(test_readers_never_see_a_torn_frame);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// StaticStackPool: slots are reused once their task has finished, and a
+// hard-killed task gives its slot and captures back too.
+
+static std::atomic<int> callbacks{0};
+
+// Counts live copies, so a test can tell whether a task's body was freed.
+struct Tracker {
+  static std::atomic<int> live;
+  Tracker() { live++; }
+  Tracker(const Tracker&) { live++; }
+  ~Tracker() { live--; }
+};
+
+std::atomic<int> Tracker::live{0};
+
+static TaskConfig onSmallStack() {
+  TaskConfig taskConfig;
+  taskConfig.dedicated = true;
+  taskConfig.stackSize = 2048;
+  return taskConfig;
+}
+
+static bool waitUntil(bool (*done)(), uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    Async::update();
+    delay(1);
+  }
+  return true;
+}
+
+static bool poolIdle() {
+  StackPoolStats stats = Async::stackPoolStats();
+  for (const StackClassStats& cls : stats.classes) {
+    if (cls.inUse != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setUp(void) {
+  callbacks = 0;
+}
+
+void tearDown(void) {}
+
+void test_finished_tasks_give_their_slot_back(void) {
+  StackPoolStats before = Async::stackPoolStats();
+  for (int i = 0; i < 10; i++) {
+    Async::Run([]() {}, []() { callbacks++; }, onSmallStack());
+    TEST_ASSERT_TRUE(waitUntil([]() { return callbacks.load() > 0; }, 500));
+    TEST_ASSERT_TRUE(waitUntil(poolIdle, 500));
+    callbacks = 0;
+  }
+  StackPoolStats after = Async::stackPoolStats();
+  TEST_ASSERT_EQUAL(10, after.classes[0].hits - before.classes[0].hits);
+  TEST_ASSERT_EQUAL(0, after.dynamicFallbacks - before.dynamicFallbacks);
+}
+
+void test_a_killed_task_frees_its_slot_and_captures(void) {
+  {
+    Tracker tracker;
+    Task task = Async::Run([tracker]() {
+      while (true) {
+        delay(1);
+      }
+    }, []() { callbacks++; }, onSmallStack());
+    delay(20);
+    TEST_ASSERT_EQUAL(1, Async::stackPoolStats().classes[0].inUse);
+    task.cancel();
+    uint32_t start = millis();
+    while (task.getState() != TaskState::Cancelled && millis() - start < 500) {
+      delay(1);
+    }
+    TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+  }
+  TEST_ASSERT_TRUE(waitUntil(poolIdle, 500));
+  TEST_ASSERT_EQUAL(0, Tracker::live.load());
+  TEST_ASSERT_EQUAL(0, callbacks.load());
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxConcurrentTasks = 0;
+  config.cancelGraceMs = 20;
+  config.useStaticStacks = true;
+  config.stackClasses[0] = StackClass{2048, 1};
+  config.stackClasses[1] = StackClass{4096, 1};
+  config.stackClasses[2] = StackClass{8192, 1};
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_finished_tasks_give_their_slot_back);
+  RUN_TEST(test_a_killed_task_frees_its_slot_and_captures);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
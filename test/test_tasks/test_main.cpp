@@ -0,0 +1,386 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// The task state machine, cancellation, admission control and timeouts.
+
+static AsyncConfig config;
+static std::atomic<int> callbacks{0};
+static std::atomic<bool> release{false};
+
+// Counts live copies, so a test can tell whether a task's body was freed.
+struct Tracker {
+  static std::atomic<int> live;
+  Tracker() { live++; }
+  Tracker(const Tracker&) { live++; }
+  ~Tracker() { live--; }
+};
+
+std::atomic<int> Tracker::live{0};
+
+static bool waitUntil(bool (*done)(), uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    Async::update();
+    delay(1);
+  }
+  return true;
+}
+
+static void setMaxConcurrent(uint16_t count) {
+  config.maxConcurrentTasks = count;
+  Async::setConfig(config);
+}
+
+void setUp(void) {
+  callbacks = 0;
+  release = false;
+}
+
+void tearDown(void) {
+  release = true;
+  config.pendingOverflow = PendingPolicy::Reject;
+  setMaxConcurrent(0);
+}
+
+void test_final_states_are_never_left(void) {
+  TaskHandle handle;
+  TEST_ASSERT_TRUE(handle.getState() == TaskState::Pending);
+  TEST_ASSERT_TRUE(handle.markStarted());
+  TEST_ASSERT_FALSE(handle.markStarted());
+  TEST_ASSERT_TRUE(handle.getState() == TaskState::Running);
+  TEST_ASSERT_TRUE(handle.setState(TaskState::Completed));
+  TEST_ASSERT_FALSE(handle.setState(TaskState::Cancelled));
+  TEST_ASSERT_FALSE(handle.setState(TaskState::Failed));
+  TEST_ASSERT_FALSE(handle.setState(TaskState::Running));
+  TEST_ASSERT_TRUE(handle.getState() == TaskState::Completed);
+}
+
+void test_a_finished_task_never_starts(void) {
+  TaskHandle handle;
+  TEST_ASSERT_TRUE(handle.setState(TaskState::Cancelled));
+  TEST_ASSERT_FALSE(handle.markStarted());
+  TEST_ASSERT_TRUE(handle.getState() == TaskState::Cancelled);
+  TEST_ASSERT_FALSE(handle.isRunning());
+}
+
+// Two tasks race to finish the same handle; exactly one may win. Plain
+// kernel tasks, so nothing of the library outlives the round.
+static std::shared_ptr<TaskHandle> contested;
+static std::atomic<bool> go{false};
+static std::atomic<int> waiting{0};
+static std::atomic<int> finished{0};
+static std::atomic<int> winners{0};
+
+static void racer(void* target) {
+  waiting++;
+  while (!go) {
+  }
+  if (contested->setState(*static_cast<TaskState*>(target))) {
+    winners++;
+  }
+  finished++;
+  vTaskDelete(nullptr);
+}
+
+void test_racing_transitions_have_one_winner(void) {
+  static TaskState completed = TaskState::Completed;
+  static TaskState cancelled = TaskState::Cancelled;
+  for (int round = 0; round < 100; round++) {
+    contested = std::make_shared<TaskHandle>();
+    contested->markStarted();
+    go = false;
+    waiting = 0;
+    finished = 0;
+    winners = 0;
+    TEST_ASSERT_TRUE(xTaskCreate(racer, "racer", 2048, &completed, 1, nullptr) == pdPASS);
+    TEST_ASSERT_TRUE(xTaskCreate(racer, "racer", 2048, &cancelled, 1, nullptr) == pdPASS);
+    TEST_ASSERT_TRUE(waitUntil([]() { return waiting.load() == 2; }, 500));
+    go = true;
+    TEST_ASSERT_TRUE(waitUntil([]() { return finished.load() == 2; }, 500));
+    TEST_ASSERT_EQUAL(1, winners.load());
+    TaskState state = contested->getState();
+    TEST_ASSERT_TRUE(state == TaskState::Completed || state == TaskState::Cancelled);
+  }
+  contested.reset();
+}
+
+// A cancel that races completion either wins, and the callback never runs,
+// or loses, and the task completes with exactly one callback.
+void test_cancel_racing_completion_settles_once(void) {
+  for (int round = 0; round < 100; round++) {
+    callbacks = 0;
+    Task task = Async::Run([]() {}, []() { callbacks++; });
+    if (round % 2 == 0) {
+      delayMicroseconds(round * 10);
+    }
+    task.cancel();
+    uint32_t start = millis();
+    while (task.getState() == TaskState::Pending || task.getState() == TaskState::Running) {
+      TEST_ASSERT_TRUE(millis() - start < 500);
+      delay(1);
+    }
+    if (task.getState() == TaskState::Completed) {
+      TEST_ASSERT_TRUE(waitUntil([]() { return callbacks.load() > 0; }, 500));
+      Async::update();
+      TEST_ASSERT_EQUAL(1, callbacks.load());
+    } else {
+      delay(2);
+      Async::update();
+      TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+      TEST_ASSERT_EQUAL(0, callbacks.load());
+    }
+  }
+}
+
+void test_cooperative_cancel_skips_the_callback(void) {
+  static std::atomic<bool> stopped{false};
+  stopped = false;
+  Task task = Async::Run([](CancellationToken token) {
+    while (!token.isCancellationRequested()) {
+      delay(1);
+    }
+    stopped = true;
+  }, []() { callbacks++; });
+  delay(20);
+  TEST_ASSERT_TRUE(task.isRunning());
+  task.cancel();
+  TEST_ASSERT_TRUE(waitUntil([]() { return stopped.load(); }, 200));
+  delay(10);
+  Async::update();
+  TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+  TEST_ASSERT_EQUAL(0, callbacks.load());
+}
+
+void test_cancel_kills_a_stuck_dedicated_task(void) {
+  {
+    Tracker tracker;
+    TaskConfig taskConfig;
+    taskConfig.dedicated = true;
+    Task task = Async::Run([tracker]() {
+      while (true) {
+        delay(1);
+      }
+    }, []() { callbacks++; }, taskConfig);
+    delay(20);
+    task.cancel();
+    uint32_t start = millis();
+    while (task.getState() != TaskState::Cancelled && millis() - start < 500) {
+      delay(1);
+    }
+    TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+  }
+  delay(50);
+  TEST_ASSERT_EQUAL(0, Tracker::live.load());
+  TEST_ASSERT_EQUAL(0, callbacks.load());
+}
+
+static void spinForever(void*) {
+  while (true) {
+    delay(1);
+  }
+}
+
+void test_cancel_before_the_handle_is_set_still_kills(void) {
+  std::shared_ptr<TaskHandle> handle = std::make_shared<TaskHandle>();
+  TEST_ASSERT_TRUE(handle->markStarted());
+  handle->cancel();
+  TaskHandle_t spinner = nullptr;
+  TEST_ASSERT_TRUE(xTaskCreate(spinForever, "spinner", 2048, nullptr, 1, &spinner) == pdPASS);
+  handle->setHandle(spinner);
+  uint32_t start = millis();
+  while (eTaskGetState(spinner) != eDeleted && millis() - start < 500) {
+    delay(1);
+  }
+  TEST_ASSERT_TRUE(eTaskGetState(spinner) == eDeleted);
+  TEST_ASSERT_TRUE(handle->getState() == TaskState::Cancelled);
+}
+
+void test_admission_queues_then_rejects(void) {
+  setMaxConcurrent(2);
+  AdmissionStats before = Async::admissionStats();
+  Task tasks[4];
+  for (Task& task : tasks) {
+    task = Async::Run([]() {
+      while (!release) {
+        delay(1);
+      }
+    }, []() { callbacks++; });
+  }
+  delay(20);
+  AdmissionStats held = Async::admissionStats();
+  TEST_ASSERT_EQUAL(2, held.running);
+  TEST_ASSERT_EQUAL(2, held.pending);
+
+  Task rejected = Async::Run([]() {}, []() { callbacks++; });
+  TEST_ASSERT_TRUE(rejected.getState() == TaskState::Failed);
+  TEST_ASSERT_EQUAL(1, Async::admissionStats().rejected - before.rejected);
+
+  release = true;
+  TEST_ASSERT_TRUE(waitUntil([]() { return callbacks.load() == 4; }, 1000));
+  AdmissionStats after = Async::admissionStats();
+  TEST_ASSERT_EQUAL(0, after.running);
+  TEST_ASSERT_EQUAL(0, after.pending);
+}
+
+static Task holdSlot() {
+  Task holder = Async::Run([]() {
+    while (!release) {
+      delay(1);
+    }
+  }, []() {});
+  delay(10);
+  return holder;
+}
+
+static bool admissionIdle() {
+  AdmissionStats stats = Async::admissionStats();
+  return stats.running == 0 && stats.pending == 0;
+}
+
+void test_evicted_future_fails(void) {
+  config.pendingOverflow = PendingPolicy::DropOldest;
+  setMaxConcurrent(1);
+  Task holder = holdSlot();
+  Future<void> first = Async::Run([]() {});
+  Future<void> second = Async::Run([]() {});
+  Future<void> third = Async::Run([]() {});
+  TEST_ASSERT_TRUE(first.wait(100));
+  TEST_ASSERT_TRUE(first.failed());
+  release = true;
+  TEST_ASSERT_TRUE(second.wait(500));
+  TEST_ASSERT_TRUE(third.wait(500));
+  TEST_ASSERT_TRUE(second.ready());
+  TEST_ASSERT_TRUE(third.ready());
+}
+
+void test_future_cancelled_while_queued_fails_and_frees_its_body(void) {
+  setMaxConcurrent(1);
+  Task holder = holdSlot();
+  {
+    Tracker tracker;
+    Future<void> queued = Async::Run([tracker]() {});
+    queued.cancel();
+    TEST_ASSERT_TRUE(queued.wait(100));
+    TEST_ASSERT_TRUE(queued.failed());
+  }
+  release = true;
+  TEST_ASSERT_TRUE(waitUntil(admissionIdle, 500));
+  TEST_ASSERT_EQUAL(0, Tracker::live.load());
+}
+
+void test_future_whose_deferred_launch_fails_fails(void) {
+  setMaxConcurrent(1);
+  Task holder = holdSlot();
+  TaskConfig tooBig;
+  tooBig.dedicated = true;
+  tooBig.stackSize = 1024 * 1024;
+  Future<void> doomed = Async::Run([]() {}, tooBig);
+  TEST_ASSERT_FALSE(doomed.wait(20));
+  release = true;
+  TEST_ASSERT_TRUE(doomed.wait(500));
+  TEST_ASSERT_TRUE(doomed.failed());
+  TEST_ASSERT_TRUE(waitUntil(admissionIdle, 500));
+}
+
+void test_timeout_does_not_fire_early(void) {
+  uint32_t timeouts = Async::timedOutTasks();
+  TaskConfig taskConfig;
+  taskConfig.timeoutMs = 20;
+  for (int i = 0; i < 10; i++) {
+    Task task = Async::Run([]() { delay(5); }, []() { callbacks++; }, taskConfig);
+    TEST_ASSERT_TRUE(waitUntil([]() { return callbacks.load() > 0; }, 200));
+    TEST_ASSERT_FALSE(task.timedOut());
+    callbacks = 0;
+  }
+  TEST_ASSERT_EQUAL(0, Async::timedOutTasks() - timeouts);
+}
+
+void test_timed_out_task_holds_its_slot_until_it_returns(void) {
+  setMaxConcurrent(4);
+  TaskConfig taskConfig;
+  taskConfig.timeoutMs = 20;
+  Task task = Async::Run([]() {
+    while (!release) {
+      delay(1);
+    }
+  }, []() { callbacks++; }, taskConfig);
+  delay(80);
+  TEST_ASSERT_TRUE(task.timedOut());
+  TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+  TEST_ASSERT_EQUAL(1, Async::admissionStats().running);
+
+  release = true;
+  TEST_ASSERT_TRUE(waitUntil([]() { return Async::admissionStats().running == 0; }, 500));
+  Async::update();
+  TEST_ASSERT_EQUAL(0, callbacks.load());
+}
+
+void test_timed_out_dedicated_future_fails(void) {
+  TaskConfig taskConfig;
+  taskConfig.dedicated = true;
+  taskConfig.timeoutMs = 30;
+  Future<int> spinning = Async::Run([]() -> int {
+    while (true) {
+      delay(1);
+    }
+  }, taskConfig);
+  TEST_ASSERT_TRUE(spinning.wait(500));
+  TEST_ASSERT_TRUE(spinning.failed());
+  TEST_ASSERT_TRUE(waitUntil(admissionIdle, 500));
+}
+
+void test_timed_out_future_fails_before_its_body_returns(void) {
+  TaskConfig taskConfig;
+  taskConfig.timeoutMs = 20;
+  Future<void> slow = Async::Run([]() {
+    while (!release) {
+      delay(1);
+    }
+  }, taskConfig);
+  TEST_ASSERT_TRUE(slow.wait(200));
+  TEST_ASSERT_TRUE(slow.failed());
+  release = true;
+  TEST_ASSERT_TRUE(waitUntil(admissionIdle, 500));
+}
+
+static int runTests() {
+  config.cancelGraceMs = 20;
+  config.pendingQueueSize = 2;
+  config.pendingOverflow = PendingPolicy::Reject;
+  setMaxConcurrent(0);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_final_states_are_never_left);
+  RUN_TEST(test_a_finished_task_never_starts);
+  RUN_TEST(test_racing_transitions_have_one_winner);
+  RUN_TEST(test_cancel_racing_completion_settles_once);
+  RUN_TEST(test_cooperative_cancel_skips_the_callback);
+  RUN_TEST(test_cancel_kills_a_stuck_dedicated_task);
+  RUN_TEST(test_cancel_before_the_handle_is_set_still_kills);
+  RUN_TEST(test_admission_queues_then_rejects);
+  RUN_TEST(test_evicted_future_fails);
+  RUN_TEST(test_future_cancelled_while_queued_fails_and_frees_its_body);
+  RUN_TEST(test_future_whose_deferred_launch_fails_fails);
+  RUN_TEST(test_timeout_does_not_fire_early);
+  RUN_TEST(test_timed_out_task_holds_its_slot_until_it_returns);
+  RUN_TEST(test_timed_out_dedicated_future_fails);
+  RUN_TEST(test_timed_out_future_fails_before_its_body_returns);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif
@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include <EasyAsync.h>
+#include <unity.h>
+
+// TimerService: delays are minimums, timers fire in due order, and cancel
+// stops both raw timers and RunAfter tasks.
+
+static std::atomic<int> fired{0};
+static std::atomic<int> early{0};
+static uint32_t order[8];
+
+static bool waitUntil(bool (*done)(), uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    Async::update();
+    delay(1);
+  }
+  return true;
+}
+
+static TimerId after(uint32_t delayMs, TaskFunction func) {
+  return TimerService::instance().schedule(delayMs, func);
+}
+
+void setUp(void) {
+  fired = 0;
+  early = 0;
+}
+
+void tearDown(void) {}
+
+void test_timers_never_fire_before_their_delay(void) {
+  const int count = 100;
+  for (int i = 0; i < count; i++) {
+    uint32_t delayMs = 1 + (i * 7) % 40;
+    uint32_t scheduledUs = micros();
+    TEST_ASSERT_TRUE(after(delayMs, [delayMs, scheduledUs]() {
+      if (micros() - scheduledUs < delayMs * 1000) {
+        early++;
+      }
+      fired++;
+    }) != 0);
+    if (i % 10 == 0) {
+      delayMicroseconds(2500);
+    }
+  }
+  TEST_ASSERT_TRUE(waitUntil([]() { return fired.load() == 100; }, 1000));
+  TEST_ASSERT_EQUAL(0, early.load());
+  TEST_ASSERT_EQUAL(0, Async::pendingTimers());
+}
+
+void test_timers_fire_in_due_order(void) {
+  const uint32_t delays[] = {100, 20, 80, 40, 60};
+  for (uint32_t delayMs : delays) {
+    after(delayMs, [delayMs]() {
+      order[fired.load()] = delayMs;
+      fired++;
+    });
+  }
+  TEST_ASSERT_TRUE(waitUntil([]() { return fired.load() == 5; }, 1000));
+  uint32_t expected[] = {20, 40, 60, 80, 100};
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(expected[i], order[i]);
+  }
+}
+
+void test_zero_delay_still_fires(void) {
+  after(0, []() { fired++; });
+  TEST_ASSERT_TRUE(waitUntil([]() { return fired.load() == 1; }, 100));
+}
+
+void test_cancelled_timer_never_fires(void) {
+  TimerId id = after(30, []() { fired++; });
+  TEST_ASSERT_TRUE(id != 0);
+  TEST_ASSERT_TRUE(TimerService::instance().cancel(id));
+  TEST_ASSERT_FALSE(TimerService::instance().cancel(id));
+  delay(60);
+  TEST_ASSERT_EQUAL(0, fired.load());
+  TEST_ASSERT_EQUAL(0, Async::pendingTimers());
+}
+
+void test_run_after_waits_for_its_delay(void) {
+  static uint32_t ranAfterMs = 0;
+  uint32_t start = millis();
+  Task task = Async::RunAfter(40, [start]() { ranAfterMs = millis() - start; }, []() { fired++; });
+  TEST_ASSERT_TRUE(waitUntil([]() { return fired.load() == 1; }, 500));
+  TEST_ASSERT_GREATER_OR_EQUAL(40, ranAfterMs);
+  TEST_ASSERT_TRUE(task.getState() == TaskState::Completed);
+}
+
+void test_cancelled_run_after_never_runs(void) {
+  static std::atomic<bool> bodyRan{false};
+  Task task = Async::RunAfter(40, []() { bodyRan = true; }, []() { fired++; });
+  task.cancel();
+  TEST_ASSERT_TRUE(task.getState() == TaskState::Cancelled);
+  delay(80);
+  Async::update();
+  TEST_ASSERT_FALSE(bodyRan.load());
+  TEST_ASSERT_EQUAL(0, fired.load());
+}
+
+static int runTests() {
+  AsyncConfig config;
+  config.maxTimers = 128;
+  config.maxConcurrentTasks = 0;
+  Async::setConfig(config);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_timers_never_fire_before_their_delay);
+  RUN_TEST(test_timers_fire_in_due_order);
+  RUN_TEST(test_zero_delay_still_fires);
+  RUN_TEST(test_cancelled_timer_never_fires);
+  RUN_TEST(test_run_after_waits_for_its_delay);
+  RUN_TEST(test_cancelled_run_after_never_runs);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runTests();
+}
+
+void loop() {}
+#else
+int main(int, char**) {
+  return runTests();
+}
+#endif